@@ -0,0 +1,66 @@
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "framing.h"
+
+void frame_reader_init(frame_reader *r, size_t frame_size) {
+    r->frame_size = frame_size;
+    r->len = 0;
+}
+
+/*
+ * Drains everything queued on fd and copies the newest complete frame into
+ * frame; older complete frames are dropped as stale and a trailing partial
+ * frame is kept for the next call. With block set, waits until at least one
+ * complete frame has arrived. Returns the number of complete frames consumed,
+ * 0 if none is complete yet, or -1 once the peer is gone and nothing was read.
+ */
+int frame_read_latest(int fd, frame_reader *r, void *frame, int block) {
+    ssize_t n;
+    size_t count;
+    int frames = 0;
+
+    while (1) {
+        n = recv(fd, r->buf + r->len, FRAME_BUFFER - r->len, (block && frames == 0) ? 0 : MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return frames;
+            }
+            return frames > 0 ? frames : -1;
+        } else if (n == 0) {
+            return frames > 0 ? frames : -1;
+        }
+        r->len += n;
+
+        // Keep the latest complete frame and move the partial tail to the front
+        count = r->len / r->frame_size;
+        if (count > 0) {
+            memcpy(frame, r->buf + (count - 1) * r->frame_size, r->frame_size);
+            r->len -= count * r->frame_size;
+            memmove(r->buf, r->buf + count * r->frame_size, r->len);
+            frames += count;
+        }
+    }
+}
+
+int write_frame(int fd, const void *frame, size_t size) {
+    const char *p = frame;
+    ssize_t n;
+
+    while (size > 0) {
+        if ((n = write(fd, p, size)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        size -= n;
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <stddef.h>
+
+#define FRAME_BUFFER 4096
+
+// Reassembles fixed-size messages from a stream socket
+typedef struct frame_reader {
+    size_t frame_size;
+    size_t len;
+    char buf[FRAME_BUFFER];
+} frame_reader;
+
+void frame_reader_init(frame_reader *r, size_t frame_size);
+int frame_read_latest(int fd, frame_reader *r, void *frame, int block);
+int write_frame(int fd, const void *frame, size_t size);
+
+#endif
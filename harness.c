@@ -0,0 +1,516 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <stdint.h>
+#include "structs.h"
+#include "server.h"
+
+/*
+ * Differential test and benchmark harness. One scripted game is replayed,
+ * without agent processes, through the reference engine (get_state,
+ * handle_request, move_actor and update_map as the server runs them) and
+ * through every variant. The map and every reply are hashed after each tick;
+ * the first tick where a variant's hashes leave the reference's is replayed
+ * once more and the differing cells and replies are printed. Each engine is
+ * timed over a few rounds and reported against the reference.
+ *
+ * The script is the agents' own greedy policy applied to the engine's
+ * replies, with seeded random steps mixed in so stuck actors keep moving and
+ * rejected moves get exercised. While two engines agree they see the same
+ * moves, so any difference in a reply shows up as a divergence.
+ *
+ * Engines: reference, cache (-c), typed and fixed (-K), cache-kernels (-c
+ * with the kernels the server picks by default), tile (-t). fixed is skipped
+ * when the map width has no fixed-width kernels. Options that change the game
+ * on purpose (-P, -H) are not engines here.
+ *
+ * tile answers every state the way a tile of distributed mode does, from the
+ * rows of the actor's strip and its halo alone, split into -t tiles. Only the
+ * answers the strip reports as exact are kept; past the halo a tile goes by
+ * the coarse summary, approximate on purpose, and the reference stands in.
+ * Moves across strips are plain moves here, migrations are not modelled.
+ * The io_uring backend (-u) and the framed reader only change how requests
+ * reach the server, not what it answers, and there are no agents here.
+ *
+ * Usage: ./harness [-n ticks] [-s seed] [-r rounds] [-t tiles] [-e engine]... < input
+ * Exit status is 1 when any engine diverges.
+ */
+
+#define DEFAULT_TICKS 10000
+#define DEFAULT_ROUNDS 3
+#define DEFAULT_TILES 4
+#define MAX_DIFFS 10
+
+typedef struct game {
+    int map_width, map_height;
+    int hunter_count, prey_count;
+    int alive_hunter_count, alive_prey_count;
+    uint16_t *map;
+    Hunter *hunters;
+    Prey *preys;
+    server_message *h_state, *p_state;
+    int (*h_pipes)[2], (*p_pipes)[2];
+    struct pollfd *pfd_h, *pfd_p;
+} game;
+
+typedef struct engine {
+    const char *name;
+    // Returns -1 when the engine does not apply to this game
+    int (*setup)(game *g);
+    server_message (*state)(uint16_t *map, actor_t a, int index, int x, int y,
+                            int map_width, int map_height);
+    uint8_t (*request)(ph_message request, uint16_t *map, Hunter *hunters, Prey *preys,
+                       actor_t a, int index, int map_width);
+    void (*teardown)(void);
+} engine;
+
+static server_message reference_state(uint16_t *map, actor_t a, int index, int x, int y,
+                                      int map_width, int map_height) {
+    return get_state(map, a, x, y, map_width, map_height);
+}
+
+static server_message kernels_state(uint16_t *map, actor_t a, int index, int x, int y,
+                                    int map_width, int map_height) {
+    return kernel_state(map, a, x, y, map_width, map_height);
+}
+
+static int tile_count = DEFAULT_TILES;
+
+static server_message tile_state(uint16_t *map, actor_t a, int index, int x, int y,
+                                 int map_width, int map_height) {
+    server_message state;
+    coordinate pos = { .x = x, .y = y };
+    int origin, rows;
+
+    tile_strip(y, tile_count, map_height, &origin, &rows);
+    if (!tile_strip_state(&map[get1D(0, origin, map_width)], a, pos, origin, rows,
+                          map_width, map_height, &state)) {
+        state = get_state(map, a, x, y, map_width, map_height);
+    }
+    return state;
+}
+
+static int reference_setup(game *g) {
+    return kernels_init(g->map_width, "generic");
+}
+
+static int cache_setup(game *g) {
+    nearest_init(g->hunters, g->hunter_count, g->preys, g->prey_count, g->map_width, g->map_height);
+    return kernels_init(g->map_width, "generic");
+}
+
+static int typed_setup(game *g) {
+    return kernels_init(g->map_width, "typed");
+}
+
+static int fixed_setup(game *g) {
+    return kernels_init(g->map_width, "fixed");
+}
+
+static int cache_kernels_setup(game *g) {
+    nearest_init(g->hunters, g->hunter_count, g->preys, g->prey_count, g->map_width, g->map_height);
+    return kernels_init(g->map_width, NULL);
+}
+
+static int tile_setup(game *g) {
+    return kernels_init(g->map_width, NULL);
+}
+
+static const engine engines[] = {
+    { "reference", reference_setup, reference_state, handle_request, NULL },
+    { "cache", cache_setup, nearest_state, handle_request, nearest_close },
+    { "typed", typed_setup, kernels_state, kernel_request, NULL },
+    { "fixed", fixed_setup, kernels_state, kernel_request, NULL },
+    { "cache-kernels", cache_kernels_setup, nearest_state, kernel_request, nearest_close },
+    { "tile", tile_setup, tile_state, kernel_request, NULL },
+};
+
+#define ENGINE_COUNT (int)(sizeof(engines) / sizeof(engines[0]))
+
+static uint64_t next_random(uint64_t *rng) {
+    // xorshift64*
+    *rng ^= *rng >> 12;
+    *rng ^= *rng << 25;
+    *rng ^= *rng >> 27;
+    return *rng * 0x2545F4914F6CDD1DULL;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size) {
+    const uint8_t *p = data;
+    size_t i;
+
+    // FNV-1a
+    for (i = 0; i < size; ++i) {
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t hash_state(uint64_t h, server_message *state) {
+    h = hash_bytes(h, &state->pos, sizeof(coordinate));
+    h = hash_bytes(h, &state->adv_pos, sizeof(coordinate));
+    h = hash_bytes(h, &state->object_count, sizeof(int));
+    return hash_bytes(h, state->object_pos, state->object_count * sizeof(coordinate));
+}
+
+// One step of the script: mostly what hunter.c and prey.c would ask for
+static ph_message script_move(uint64_t *rng, actor_t a, server_message *state,
+                              int map_width, int map_height) {
+    static const coordinate steps[4] = { {0, -1}, {1, 0}, {0, 1}, {-1, 0} };
+    uint64_t r = next_random(rng);
+    coordinate pos = state->pos, candidate, best = state->pos;
+    int i, j, dist, best_dist = manhattan_dist(state->pos, state->adv_pos), blocked;
+    ph_message request;
+
+    for (i = 0; i < 4; ++i) {
+        candidate = (coordinate){ pos.x + steps[i].x, pos.y + steps[i].y };
+        if (candidate.x < 0 || candidate.y < 0 || candidate.x >= map_width || candidate.y >= map_height) {
+            continue;
+        }
+        // A random step ignores the neighbours, the server has to reject it
+        if (r % 4 == 0) {
+            if ((int)((r >> 8) % 4) == i) {
+                best = candidate;
+            }
+            continue;
+        }
+        for (j = 0, blocked = 0; j < state->object_count; ++j) {
+            blocked |= state->object_pos[j].x == candidate.x && state->object_pos[j].y == candidate.y;
+        }
+        dist = manhattan_dist(candidate, state->adv_pos);
+        if (!blocked && (a == HUNTER ? dist < best_dist : dist > best_dist)) {
+            best_dist = dist;
+            best = candidate;
+        }
+    }
+
+    request.move_request = best;
+    return request;
+}
+
+static void read_game(game *g) {
+    int i, obs_count;
+    Obstacle obs;
+
+    memset(g, 0, sizeof(game));
+    scanf("%d %d", &g->map_width, &g->map_height);
+    scanf("%d", &obs_count);
+    g->map = calloc(g->map_width * g->map_height, sizeof(uint16_t));
+    for (i = 0; i < obs_count; ++i) {
+        scanf("%d %d", &obs.pos.y, &obs.pos.x);
+        g->map[get1D(obs.pos.x, obs.pos.y, g->map_width)] = OBSTACLE;
+    }
+
+    scanf("%d", &g->hunter_count);
+    g->hunters = calloc(g->hunter_count + 1, sizeof(Hunter));
+    for (i = 0; i < g->hunter_count; ++i) {
+        scanf("%d %d %d", &g->hunters[i].pos.y, &g->hunters[i].pos.x, &g->hunters[i].energy);
+        g->hunters[i].alive = 1;
+        g->hunters[i].pid = -1;
+        g->map[get1D(g->hunters[i].pos.x, g->hunters[i].pos.y, g->map_width)] = encode_actor(HUNTER, i);
+    }
+
+    scanf("%d", &g->prey_count);
+    g->preys = calloc(g->prey_count + 1, sizeof(Prey));
+    for (i = 0; i < g->prey_count; ++i) {
+        scanf("%d %d %d", &g->preys[i].pos.y, &g->preys[i].pos.x, &g->preys[i].stored_energy);
+        g->preys[i].alive = 1;
+        g->preys[i].pid = -1;
+        g->map[get1D(g->preys[i].pos.x, g->preys[i].pos.y, g->map_width)] = encode_actor(PREY, i);
+    }
+
+    g->alive_hunter_count = g->hunter_count;
+    g->alive_prey_count = g->prey_count;
+}
+
+static void copy_game(game *dst, const game *src) {
+    size_t cells = src->map_width * src->map_height;
+    int i;
+
+    *dst = *src;
+    dst->map = malloc(cells * sizeof(uint16_t));
+    dst->hunters = malloc((src->hunter_count + 1) * sizeof(Hunter));
+    dst->preys = malloc((src->prey_count + 1) * sizeof(Prey));
+    dst->h_state = calloc(src->hunter_count + 1, sizeof(server_message));
+    dst->p_state = calloc(src->prey_count + 1, sizeof(server_message));
+    memcpy(dst->map, src->map, cells * sizeof(uint16_t));
+    memcpy(dst->hunters, src->hunters, src->hunter_count * sizeof(Hunter));
+    memcpy(dst->preys, src->preys, src->prey_count * sizeof(Prey));
+
+    // No agents behind the actors, update_map closes and kills nothing
+    dst->h_pipes = malloc((src->hunter_count + 1) * sizeof(int[2]));
+    dst->p_pipes = malloc((src->prey_count + 1) * sizeof(int[2]));
+    dst->pfd_h = malloc((src->hunter_count + 1) * sizeof(struct pollfd));
+    dst->pfd_p = malloc((src->prey_count + 1) * sizeof(struct pollfd));
+    for (i = 0; i < src->hunter_count; ++i) {
+        dst->h_pipes[i][0] = dst->h_pipes[i][1] = dst->pfd_h[i].fd = -1;
+    }
+    for (i = 0; i < src->prey_count; ++i) {
+        dst->p_pipes[i][0] = dst->p_pipes[i][1] = dst->pfd_p[i].fd = -1;
+    }
+}
+
+static void free_game(game *g) {
+    free(g->map);
+    free(g->hunters);
+    free(g->preys);
+    free(g->h_state);
+    free(g->p_state);
+    free(g->h_pipes);
+    free(g->p_pipes);
+    free(g->pfd_h);
+    free(g->pfd_p);
+}
+
+/*
+ * Plays up to tick_limit ticks in the order of the server's main loop: every
+ * hunter, every prey, then update_map. With hashes, two per tick are stored
+ * (map, replies). Stops after tick stop_at when it is not negative, leaving
+ * the game in g. Returns the number of ticks played, -1 when the engine does
+ * not apply.
+ */
+static int play(const engine *e, const game *start, game *g, uint64_t seed, int tick_limit,
+                uint64_t *hashes, int stop_at) {
+    int i, tick, w, h;
+    uint8_t map_updated;
+    uint64_t rng = seed, hash;
+    ph_message request;
+
+    copy_game(g, start);
+    w = g->map_width;
+    h = g->map_height;
+    if (e->setup(g) < 0) {
+        if (e->teardown != NULL) {
+            e->teardown();
+        }
+        return -1;
+    }
+
+    // Initial states, as setup_children hands them out
+    for (i = 0; i < g->hunter_count; ++i) {
+        g->h_state[i] = e->state(g->map, HUNTER, i, g->hunters[i].pos.x, g->hunters[i].pos.y, w, h);
+    }
+    for (i = 0; i < g->prey_count; ++i) {
+        g->p_state[i] = e->state(g->map, PREY, i, g->preys[i].pos.x, g->preys[i].pos.y, w, h);
+    }
+
+    for (tick = 0; tick < tick_limit && g->alive_hunter_count > 0 && g->alive_prey_count > 0; ++tick) {
+        map_updated = 0;
+        for (i = 0; i < g->hunter_count; ++i) {
+            if (g->hunters[i].alive) {
+                request = script_move(&rng, HUNTER, &g->h_state[i], w, h);
+                map_updated |= e->request(request, g->map, g->hunters, g->preys, HUNTER, i, w);
+                g->h_state[i] = e->state(g->map, HUNTER, i, g->hunters[i].pos.x, g->hunters[i].pos.y, w, h);
+            }
+        }
+        for (i = 0; i < g->prey_count; ++i) {
+            if (g->preys[i].alive) {
+                request = script_move(&rng, PREY, &g->p_state[i], w, h);
+                map_updated |= e->request(request, g->map, g->hunters, g->preys, PREY, i, w);
+                g->p_state[i] = e->state(g->map, PREY, i, g->preys[i].pos.x, g->preys[i].pos.y, w, h);
+            }
+        }
+        if (map_updated) {
+            update_map(g->map, w, g->hunters, g->hunter_count, g->preys, g->prey_count,
+                       &g->alive_prey_count, &g->alive_hunter_count, g->h_pipes, g->p_pipes,
+                       g->pfd_h, g->pfd_p);
+        }
+
+        if (hashes != NULL) {
+            hashes[2 * tick] = hash_bytes(0xcbf29ce484222325ULL, g->map, w * h * sizeof(uint16_t));
+            hash = 0xcbf29ce484222325ULL;
+            for (i = 0; i < g->hunter_count; ++i) {
+                if (g->hunters[i].alive) {
+                    hash = hash_state(hash, &g->h_state[i]);
+                }
+            }
+            for (i = 0; i < g->prey_count; ++i) {
+                if (g->preys[i].alive) {
+                    hash = hash_state(hash, &g->p_state[i]);
+                }
+            }
+            hashes[2 * tick + 1] = hash;
+        }
+        if (tick == stop_at) {
+            tick++;
+            break;
+        }
+    }
+
+    if (e->teardown != NULL) {
+        e->teardown();
+    }
+    return tick;
+}
+
+static double seconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int same_state(server_message *a, server_message *b) {
+    return hash_state(0, a) == hash_state(0, b);
+}
+
+static void report_divergence(const engine *e, const game *start, uint64_t seed, int tick_limit, int tick) {
+    game ref, var;
+    int i, shown = 0, w = start->map_width;
+
+    play(&engines[0], start, &ref, seed, tick_limit, NULL, tick);
+    play(e, start, &var, seed, tick_limit, NULL, tick);
+
+    for (i = 0; i < w * start->map_height && shown < MAX_DIFFS; ++i) {
+        if (ref.map[i] != var.map[i]) {
+            printf("    cell (%d, %d): reference %d/%d, %s %d/%d\n", i % w, i / w,
+                   decode_actor(ref.map[i]), decode_index(ref.map[i]), e->name,
+                   decode_actor(var.map[i]), decode_index(var.map[i]));
+            shown++;
+        }
+    }
+    for (i = 0; i < start->hunter_count && shown < MAX_DIFFS; ++i) {
+        if (ref.hunters[i].alive && !same_state(&ref.h_state[i], &var.h_state[i])) {
+            printf("    hunter %d at (%d, %d): adversary reference (%d, %d), %s (%d, %d)\n", i,
+                   ref.h_state[i].pos.x, ref.h_state[i].pos.y, ref.h_state[i].adv_pos.x,
+                   ref.h_state[i].adv_pos.y, e->name, var.h_state[i].adv_pos.x, var.h_state[i].adv_pos.y);
+            shown++;
+        }
+    }
+    for (i = 0; i < start->prey_count && shown < MAX_DIFFS; ++i) {
+        if (ref.preys[i].alive && !same_state(&ref.p_state[i], &var.p_state[i])) {
+            printf("    prey %d at (%d, %d): adversary reference (%d, %d), %s (%d, %d)\n", i,
+                   ref.p_state[i].pos.x, ref.p_state[i].pos.y, ref.p_state[i].adv_pos.x,
+                   ref.p_state[i].adv_pos.y, e->name, var.p_state[i].adv_pos.x, var.p_state[i].adv_pos.y);
+            shown++;
+        }
+    }
+
+    free_game(&ref);
+    free_game(&var);
+}
+
+int main(int argc, char **argv) {
+    int opt, i, j, k, round;
+    int tick_limit = DEFAULT_TICKS, rounds = DEFAULT_ROUNDS, diverged = 0;
+    uint64_t seed = 1;
+    uint8_t selected[ENGINE_COUNT] = {0};
+    int any_selected = 0;
+    int ticks[ENGINE_COUNT];
+    double best[ENGINE_COUNT], t;
+    uint64_t *hashes[ENGINE_COUNT];
+    game start, g;
+
+    while ((opt = getopt(argc, argv, "n:s:r:t:e:")) != -1) {
+        switch (opt) {
+            case 'n':
+                tick_limit = atoi(optarg);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            case 't':
+                tile_count = atoi(optarg);
+                break;
+            case 'e':
+                for (i = 0; i < ENGINE_COUNT && strcmp(engines[i].name, optarg) != 0; ++i);
+                if (i == ENGINE_COUNT) {
+                    fprintf(stderr, "Unknown engine: %s\n", optarg);
+                    exit(1);
+                }
+                selected[i] = 1;
+                any_selected = 1;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n ticks] [-s seed] [-r rounds] [-t tiles] [-e engine]... < input\n", argv[0]);
+                exit(1);
+        }
+    }
+    if (tick_limit <= 0 || rounds <= 0 || tile_count <= 0) {
+        fprintf(stderr, "Ticks, rounds and tiles must be positive\n");
+        exit(1);
+    }
+    // xorshift never leaves 0
+    if (seed == 0) {
+        seed = 1;
+    }
+
+    // The reference always runs, the variants default to all of them
+    for (i = 0; i < ENGINE_COUNT; ++i) {
+        selected[i] |= (i == 0) || !any_selected;
+    }
+
+    read_game(&start);
+
+    for (i = 0; i < ENGINE_COUNT; ++i) {
+        if (!selected[i]) {
+            continue;
+        }
+        hashes[i] = malloc(2 * tick_limit * sizeof(uint64_t));
+        ticks[i] = play(&engines[i], &start, &g, seed, tick_limit, hashes[i], -1);
+        free_game(&g);
+        if (ticks[i] < 0) {
+            continue;
+        }
+
+        best[i] = 0;
+        for (round = 0; round < rounds; ++round) {
+            t = seconds();
+            play(&engines[i], &start, &g, seed, tick_limit, NULL, -1);
+            t = seconds() - t;
+            free_game(&g);
+            if (round == 0 || t < best[i]) {
+                best[i] = t;
+            }
+        }
+    }
+
+    printf("%-14s %8s %12s %12s %8s\n", "engine", "ticks", "seconds", "us/tick", "speedup");
+    for (i = 0; i < ENGINE_COUNT; ++i) {
+        if (!selected[i]) {
+            continue;
+        }
+        if (ticks[i] < 0) {
+            printf("%-14s  skipped, no kernels for width %d\n", engines[i].name, start.map_width);
+            continue;
+        }
+
+        // First tick whose map or replies leave the reference
+        for (k = 0; i > 0 && k < ticks[i] && k < ticks[0]; ++k) {
+            if (hashes[i][2 * k] != hashes[0][2 * k] || hashes[i][2 * k + 1] != hashes[0][2 * k + 1]) {
+                break;
+            }
+        }
+
+        printf("%-14s %8d %12.6f %12.3f %7.2fx", engines[i].name, ticks[i], best[i],
+               ticks[i] ? best[i] * 1e6 / ticks[i] : 0.0, best[i] > 0 ? best[0] / best[i] : 0.0);
+        if (i == 0) {
+            printf("\n");
+        } else if (k == ticks[i] && k == ticks[0]) {
+            printf("  ok\n");
+        } else {
+            diverged = 1;
+            if (k < ticks[i] && k < ticks[0]) {
+                j = hashes[i][2 * k] != hashes[0][2 * k];
+                printf("  DIVERGES at tick %d (%s)\n", k, j ? "map" : "replies");
+                report_divergence(&engines[i], &start, seed, tick_limit, k);
+            } else {
+                printf("  DIVERGES: game ends after %d ticks, reference after %d\n", ticks[i], ticks[0]);
+            }
+        }
+    }
+
+    for (i = 0; i < ENGINE_COUNT; ++i) {
+        if (selected[i]) {
+            free(hashes[i]);
+        }
+    }
+    free_game(&start);
+    exit(diverged);
+}
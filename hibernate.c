@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "structs.h"
+#include "server.h"
+
+/*
+ * Hibernation. An actor whose nearest adversary is farther than the range
+ * does not get its reply: the agent stays blocked on its read, its position
+ * is frozen and it costs nothing per tick. The positions every actor moved to
+ * during a tick are recorded, and at the end of the tick a sleeper is woken
+ * when an adversary arrived within range of it. Distance is symmetric, so a
+ * pair that comes close always wakes the sleeping side.
+ *
+ * If every living actor is asleep nothing can move any more, so everybody is
+ * woken and the game falls back to lockstep until a pair closes in. The same
+ * happens when the awake actors stall, every one of them twice rejected since
+ * the last accepted move (a hunter stuck behind an obstacle, say).
+ *
+ * Sleepers are kept in buckets of a grid whose cells are range wide, one grid
+ * per actor type, so a move only looks at the sleepers of the 3x3 buckets
+ * around it instead of at every sleeper.
+ *
+ * Slots are numbered hunters first, then preys, like the io_uring slots.
+ */
+
+static int range = 0;
+static int h_count, p_count;
+static uint8_t *asleep;
+static coordinate *moved_h, *moved_p;
+static int moved_h_count, moved_p_count;
+static int stalled;
+static int buckets_x, buckets_y;
+static int *h_heads, *p_heads;      // sleepers per bucket
+static int *prev, *next;            // bucket list links per slot, -1 at the ends
+static int *bucket;
+static coordinate *where;           // a sleeper's frozen position
+
+void hibernate_init(int dist, int hunter_count, int prey_count, int map_width, int map_height) {
+    int i;
+
+    range = dist;
+    h_count = hunter_count;
+    p_count = prey_count;
+    asleep = calloc(hunter_count + prey_count + 1, 1);
+    moved_h = malloc((hunter_count + 1) * sizeof(coordinate));
+    moved_p = malloc((prey_count + 1) * sizeof(coordinate));
+    moved_h_count = moved_p_count = 0;
+    stalled = 0;
+
+    if (range <= 0) {
+        return;
+    }
+    buckets_x = (map_width + range - 1) / range;
+    buckets_y = (map_height + range - 1) / range;
+    h_heads = malloc(buckets_x * buckets_y * sizeof(int));
+    p_heads = malloc(buckets_x * buckets_y * sizeof(int));
+    for (i = 0; i < buckets_x * buckets_y; ++i) {
+        h_heads[i] = -1;
+        p_heads[i] = -1;
+    }
+    prev = malloc((hunter_count + prey_count + 1) * sizeof(int));
+    next = malloc((hunter_count + prey_count + 1) * sizeof(int));
+    bucket = malloc((hunter_count + prey_count + 1) * sizeof(int));
+    where = malloc((hunter_count + prey_count + 1) * sizeof(coordinate));
+}
+
+static int *heads_of(int slot) {
+    return (slot < h_count) ? h_heads : p_heads;
+}
+
+static void fall_asleep(int slot, coordinate pos) {
+    int *heads = heads_of(slot);
+
+    asleep[slot] = 1;
+    where[slot] = pos;
+    bucket[slot] = (pos.y / range) * buckets_x + pos.x / range;
+    prev[slot] = -1;
+    next[slot] = heads[bucket[slot]];
+    if (next[slot] >= 0) {
+        prev[next[slot]] = slot;
+    }
+    heads[bucket[slot]] = slot;
+}
+
+static void stop_sleeping(int slot) {
+    if (prev[slot] >= 0) {
+        next[prev[slot]] = next[slot];
+    } else {
+        heads_of(slot)[bucket[slot]] = next[slot];
+    }
+    if (next[slot] >= 0) {
+        prev[next[slot]] = prev[slot];
+    }
+    asleep[slot] = 0;
+}
+
+int hibernate_hold(actor_t a, int index, server_message *state) {
+    int slot = (a == HUNTER) ? index : h_count + index;
+
+    if (range <= 0) {
+        return 0;
+    }
+    stalled++;
+    // get_state points at the actor itself when there is no adversary
+    if ((state->adv_pos.x != state->pos.x || state->adv_pos.y != state->pos.y)
+        && manhattan_dist(state->pos, state->adv_pos) <= range) {
+        return 0;
+    }
+    fall_asleep(slot, state->pos);
+    return 1;
+}
+
+void hibernate_moved(actor_t a, coordinate pos) {
+    if (range <= 0) {
+        return;
+    }
+    stalled = 0;
+    if (a == HUNTER) {
+        moved_h[moved_h_count++] = pos;
+    } else {
+        moved_p[moved_p_count++] = pos;
+    }
+}
+
+// Marks the sleepers of heads within range of pos
+static void arrived_at(coordinate pos, int *heads, uint8_t *wake) {
+    int bx, by, slot;
+    int cx = pos.x / range, cy = pos.y / range;
+
+    for (by = cy - 1; by <= cy + 1; ++by) {
+        for (bx = cx - 1; bx <= cx + 1; ++bx) {
+            if (bx < 0 || by < 0 || bx >= buckets_x || by >= buckets_y) {
+                continue;
+            }
+            for (slot = heads[by * buckets_x + bx]; slot >= 0; slot = next[slot]) {
+                if (manhattan_dist(where[slot], pos) <= range) {
+                    wake[slot] = 1;
+                }
+            }
+        }
+    }
+}
+
+int hibernate_wake(Hunter *hunters, Prey *preys, uint8_t *wake) {
+    int i, sleeping = 0, alive = 0, woken = 0, wake_all;
+
+    if (range <= 0) {
+        return 0;
+    }
+    memset(wake, 0, h_count + p_count);
+
+    for (i = 0; i < h_count + p_count; ++i) {
+        uint8_t is_alive = (i < h_count) ? hunters[i].alive : preys[i - h_count].alive;
+        // The dead never wake
+        if (!is_alive) {
+            if (asleep[i]) {
+                stop_sleeping(i);
+            }
+            continue;
+        }
+        alive++;
+        sleeping += asleep[i];
+    }
+
+    // Preys moving wake hunters and the other way round
+    for (i = 0; i < moved_p_count; ++i) {
+        arrived_at(moved_p[i], h_heads, wake);
+    }
+    for (i = 0; i < moved_h_count; ++i) {
+        arrived_at(moved_h[i], p_heads, wake);
+    }
+
+    // Nobody left to move, or the awake ones are stuck: wake everybody
+    wake_all = sleeping == alive || stalled > 2 * (alive - sleeping);
+    if (wake_all) {
+        stalled = 0;
+    }
+    for (i = 0; i < h_count + p_count; ++i) {
+        if (wake_all) {
+            wake[i] = asleep[i];
+        }
+        if (wake[i]) {
+            stop_sleeping(i);
+            woken++;
+        }
+    }
+
+    moved_h_count = moved_p_count = 0;
+    return woken;
+}
+
+void hibernate_close(void) {
+    free(asleep);
+    free(moved_h);
+    free(moved_p);
+    if (range > 0) {
+        free(h_heads);
+        free(p_heads);
+        free(prev);
+        free(next);
+        free(bucket);
+        free(where);
+    }
+    range = 0;
+}
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "structs.h"
+#include "server.h"
+
+/*
+ * Specialized hot-path kernels. get_state and handle_request take the actor
+ * type as an argument and test it for every cell they look at; the kernels
+ * below are generated once per actor type, and once more per common map
+ * width so the row stride is a constant. The adversary test becomes a single
+ * mask on the encoded cell:
+ *
+ *   hunters chase PREY (010) and DOUBLE (110): low two bits are 10
+ *   preys flee HUNTER (100) and DOUBLE (110): bit 2 is set
+ *
+ * The ring scan visits cells in exactly get_state's order, only skipping the
+ * parts of a ring that lie off the map, and the neighbour scan keeps
+ * get_state's quirk of not looking down once the cell above was reported.
+ * The harness checks every variant against the generic path.
+ *
+ * kernels_init picks a set at startup; the generic set is the reference code.
+ */
+
+typedef int (*scan_fn)(uint16_t *map, int x, int y, int map_width, int map_height,
+                       int start_ring, coordinate *adv_pos);
+typedef void (*neighbours_fn)(uint16_t *map, server_message *state, int map_width, int map_height);
+typedef uint8_t (*request_fn)(ph_message request, uint16_t *map, Hunter *hunters, Prey *preys,
+                              int index, int map_width);
+
+typedef struct kernel_set {
+    const char *name;
+    int width;                      // 0 for any width
+    scan_fn scan[2];                // [0] hunters, [1] preys
+    neighbours_fn neighbours[2];
+    request_fn request[2];
+} kernel_set;
+
+#define HUNTER_ADV(encd) (((encd) & 3) == 2)
+#define PREY_ADV(encd) (((encd) & 4) != 0)
+#define HUNTER_OBJ(encd) ((encd) != EMPTY && decode_actor(encd) != PREY)
+#define PREY_OBJ(encd) ((encd) != EMPTY && decode_actor(encd) != HUNTER)
+#define HUNTER_TARGET(encd) (decode_actor(encd) == EMPTY || decode_actor(encd) == PREY)
+#define PREY_TARGET(encd) (decode_actor(encd) == EMPTY || decode_actor(encd) == HUNTER)
+
+#define FOUND(cx, cy) do { adv_pos->x = (cx); adv_pos->y = (cy); return i; } while (0)
+
+#define DEFINE_SCAN(NAME, WIDTH, IS_ADV)                                                        \
+static int NAME(uint16_t *map, int x, int y, int map_width, int map_height,                     \
+                int start_ring, coordinate *adv_pos) {                                          \
+    const int w = (WIDTH);                                                                      \
+    int i, j, lo, hi, xl, xr, yu, yd;                                                           \
+    int max_dx = (x > w - 1 - x) ? x : w - 1 - x;                                               \
+    int max_dy = (y > map_height - 1 - y) ? y : map_height - 1 - y;                             \
+    /* get_state stops before the farthest ring */                                              \
+    int last = (w + map_height - 3 < max_dx + max_dy) ? w + map_height - 3 : max_dx + max_dy;   \
+                                                                                                \
+    for (i = start_ring; i <= last; ++i) {                                                      \
+        lo = (i > max_dy) ? i - max_dy : 0;                                                     \
+        hi = (i < max_dx) ? i : max_dx;                                                         \
+        for (j = lo; j <= hi; ++j) {                                                            \
+            xl = x - j;                                                                         \
+            xr = x + j;                                                                         \
+            yu = y - (i - j);                                                                   \
+            yd = y + (i - j);                                                                   \
+            if (xl >= 0) {                                                                      \
+                if (yu >= 0 && IS_ADV(map[yu * w + xl])) FOUND(xl, yu);                         \
+                if (yd < map_height && IS_ADV(map[yd * w + xl])) FOUND(xl, yd);                 \
+            }                                                                                   \
+            if (xr < w) {                                                                       \
+                if (yu >= 0 && IS_ADV(map[yu * w + xr])) FOUND(xr, yu);                         \
+                if (yd < map_height && IS_ADV(map[yd * w + xr])) FOUND(xr, yd);                 \
+            }                                                                                   \
+        }                                                                                       \
+    }                                                                                           \
+    return 0;                                                                                   \
+}
+
+#define ADD_OBJECT(cx, cy) do {                                                                 \
+    state->object_pos[n].x = (cx);                                                              \
+    state->object_pos[n].y = (cy);                                                              \
+    n++;                                                                                        \
+} while (0)
+
+#define DEFINE_NEIGHBOURS(NAME, WIDTH, IS_OBJ)                                                  \
+static void NAME(uint16_t *map, server_message *state, int map_width, int map_height) {         \
+    const int w = (WIDTH);                                                                      \
+    int x = state->pos.x, y = state->pos.y, n = 0;                                              \
+                                                                                                \
+    if (x > 0 && IS_OBJ(map[y * w + x - 1])) ADD_OBJECT(x - 1, y);                              \
+    if (y > 0 && IS_OBJ(map[(y - 1) * w + x])) ADD_OBJECT(x, y - 1);                            \
+    else if (y + 1 < map_height && IS_OBJ(map[(y + 1) * w + x])) ADD_OBJECT(x, y + 1);          \
+    if (x + 1 < w && IS_OBJ(map[y * w + x + 1])) ADD_OBJECT(x + 1, y);                          \
+    state->object_count = n;                                                                    \
+}
+
+#define DEFINE_REQUEST(NAME, WIDTH, TYPE, ACTORS, IS_TARGET, ON_MOVE)                           \
+static uint8_t NAME(ph_message request, uint16_t *map, Hunter *hunters, Prey *preys,            \
+                    int index, int map_width) {                                                 \
+    const int w = (WIDTH);                                                                      \
+    coordinate from = ACTORS[index].pos, to = request.move_request;                             \
+    uint16_t from_encd = map[from.y * w + from.x], to_encd = map[to.y * w + to.x];              \
+                                                                                                \
+    if (!IS_TARGET(to_encd)) {                                                                  \
+        return 0;                                                                               \
+    }                                                                                           \
+    move_actor(map, from.x, from.y, to.x, to.y, TYPE, w);                                       \
+    ACTORS[index].pos = to;                                                                     \
+    ON_MOVE;                                                                                    \
+    nearest_cell(from.x, from.y, from_encd, map[from.y * w + from.x]);                          \
+    nearest_cell(to.x, to.y, to_encd, map[to.y * w + to.x]);                                    \
+    nearest_moved(TYPE, index, to);                                                             \
+    return 1;                                                                                   \
+}
+
+#define DEFINE_KERNELS(SUFFIX, WIDTH)                                                           \
+    DEFINE_SCAN(scan_hunter_##SUFFIX, WIDTH, HUNTER_ADV)                                        \
+    DEFINE_SCAN(scan_prey_##SUFFIX, WIDTH, PREY_ADV)                                            \
+    DEFINE_NEIGHBOURS(neighbours_hunter_##SUFFIX, WIDTH, HUNTER_OBJ)                            \
+    DEFINE_NEIGHBOURS(neighbours_prey_##SUFFIX, WIDTH, PREY_OBJ)                                \
+    DEFINE_REQUEST(request_hunter_##SUFFIX, WIDTH, HUNTER, hunters, HUNTER_TARGET,              \
+                   hunters[index].energy--)                                                     \
+    DEFINE_REQUEST(request_prey_##SUFFIX, WIDTH, PREY, preys, PREY_TARGET, (void)0)
+
+#define KERNEL_SET(NAME, WIDTH, SUFFIX)                                                         \
+    { NAME, WIDTH, { scan_hunter_##SUFFIX, scan_prey_##SUFFIX },                                \
+      { neighbours_hunter_##SUFFIX, neighbours_prey_##SUFFIX },                                 \
+      { request_hunter_##SUFFIX, request_prey_##SUFFIX } }
+
+DEFINE_KERNELS(any, map_width)
+DEFINE_KERNELS(w8, 8)
+DEFINE_KERNELS(w16, 16)
+DEFINE_KERNELS(w32, 32)
+DEFINE_KERNELS(w64, 64)
+
+// The reference code behind the same signatures
+static int scan_hunter_generic(uint16_t *map, int x, int y, int map_width, int map_height,
+                               int start_ring, coordinate *adv_pos) {
+    return scan_adversary(map, HUNTER, x, y, map_width, map_height, start_ring, adv_pos);
+}
+
+static int scan_prey_generic(uint16_t *map, int x, int y, int map_width, int map_height,
+                             int start_ring, coordinate *adv_pos) {
+    return scan_adversary(map, PREY, x, y, map_width, map_height, start_ring, adv_pos);
+}
+
+static void neighbours_hunter_generic(uint16_t *map, server_message *state, int map_width, int map_height) {
+    scan_neighbours(map, HUNTER, state, map_width, map_height);
+}
+
+static void neighbours_prey_generic(uint16_t *map, server_message *state, int map_width, int map_height) {
+    scan_neighbours(map, PREY, state, map_width, map_height);
+}
+
+static uint8_t request_hunter_generic(ph_message request, uint16_t *map, Hunter *hunters, Prey *preys,
+                                      int index, int map_width) {
+    return handle_request(request, map, hunters, preys, HUNTER, index, map_width);
+}
+
+static uint8_t request_prey_generic(ph_message request, uint16_t *map, Hunter *hunters, Prey *preys,
+                                    int index, int map_width) {
+    return handle_request(request, map, hunters, preys, PREY, index, map_width);
+}
+
+static const kernel_set sets[] = {
+    KERNEL_SET("generic", 0, generic),
+    KERNEL_SET("typed", 0, any),
+    KERNEL_SET("fixed", 8, w8),
+    KERNEL_SET("fixed", 16, w16),
+    KERNEL_SET("fixed", 32, w32),
+    KERNEL_SET("fixed", 64, w64),
+};
+
+#define SET_COUNT (int)(sizeof(sets) / sizeof(sets[0]))
+
+static const kernel_set *active = &sets[0];
+
+#define SIDE(a) ((a) == HUNTER ? 0 : 1)
+
+/*
+ * Picks the kernel set for this map: a named one ("generic", "typed",
+ * "fixed"), or with NULL the fastest that fits, a fixed width over the typed
+ * kernels. Returns -1 when the named set has no variant for the width.
+ */
+int kernels_init(int map_width, const char *name) {
+    int i, chosen = -1;
+
+    for (i = 0; i < SET_COUNT; ++i) {
+        if (sets[i].width != 0 && sets[i].width != map_width) {
+            continue;
+        }
+        if (name != NULL ? strcmp(sets[i].name, name) == 0 : i > 0) {
+            chosen = i;
+        }
+    }
+    if (chosen < 0) {
+        return -1;
+    }
+    active = &sets[chosen];
+    return 0;
+}
+
+const char *kernels_name(void) {
+    return active->name;
+}
+
+int kernel_scan(uint16_t *map, actor_t a, int x, int y, int map_width, int map_height,
+                int start_ring, coordinate *adv_pos) {
+    return active->scan[SIDE(a)](map, x, y, map_width, map_height, start_ring, adv_pos);
+}
+
+void kernel_neighbours(uint16_t *map, actor_t a, server_message *state, int map_width, int map_height) {
+    active->neighbours[SIDE(a)](map, state, map_width, map_height);
+}
+
+server_message kernel_state(uint16_t *map, actor_t a, int x, int y, int map_width, int map_height) {
+    server_message state;
+    int side = SIDE(a);
+
+    state.pos.x = x;
+    state.pos.y = y;
+    state.adv_pos = state.pos;
+    active->scan[side](map, x, y, map_width, map_height, 1, &state.adv_pos);
+    active->neighbours[side](map, &state, map_width, map_height);
+    return state;
+}
+
+uint8_t kernel_request(ph_message request, uint16_t *map, Hunter *hunters, Prey *preys,
+                       actor_t a, int index, int map_width) {
+    return active->request[SIDE(a)](request, map, hunters, preys, index, map_width);
+}
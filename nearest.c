@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "structs.h"
+#include "server.h"
+
+/*
+ * Nearest-adversary cache. get_state scans rings of growing distance around
+ * the actor and reports the first adversary in its scan order; between two
+ * requests of the same actor that answer rarely changes. Every entry keeps
+ * the last answer and a lower bound on the ring holding the nearest
+ * adversary, and every map cell change invalidates only the entries it could
+ * affect:
+ *
+ *  - an adversary leaving the cached cell,
+ *  - an adversary arriving no farther than the cached one (ties included, the
+ *    scan order inside a ring decides those),
+ *  - the actor itself moving, which lowers the bound by one ring.
+ *
+ * An invalid entry is recomputed on the next request, scanning from its bound
+ * instead of from ring 1, so the replies stay identical to get_state.
+ *
+ * A cell change only matters to entries whose bound reaches the cell; a
+ * valid entry's bound is its cached ring, so its cached adversary is in reach
+ * too. Entries with a bound of at most NEAREST_BUCKET are kept in the bucket
+ * of a NEAREST_BUCKET grid holding their position, and a change visits the
+ * 3x3 buckets around the cell. The few entries with a larger bound, those
+ * without an adversary nearby, sit in one extra list visited every time.
+ */
+
+#define NEAREST_BUCKET 8
+
+typedef struct nearest_entry {
+    coordinate pos;         // where the actor is
+    coordinate adv_pos;     // cached answer, pos itself without adversary
+    int dist;               // ring of adv_pos
+    int min_ring;           // no adversary in the rings below
+    int bucket;             // buckets_x * buckets_y for the far list
+    int prev, next;         // bucket list links, -1 at the ends
+    uint8_t valid;
+} nearest_entry;
+
+static int enabled = 0;
+static int n_width, n_height, no_adv;
+static nearest_entry *h_entries, *p_entries;
+static int buckets_x, buckets_y;
+static int *h_heads, *p_heads;
+
+static int is_adversary(actor_t a, uint16_t encd) {
+    actor_t b = decode_actor(encd);
+
+    return b == DOUBLE || (a == HUNTER && b == PREY) || (a == PREY && b == HUNTER);
+}
+
+static void unlink_entry(nearest_entry *entries, int *heads, int i) {
+    nearest_entry *e = &entries[i];
+
+    if (e->prev >= 0) {
+        entries[e->prev].next = e->next;
+    } else {
+        heads[e->bucket] = e->next;
+    }
+    if (e->next >= 0) {
+        entries[e->next].prev = e->prev;
+    }
+}
+
+// Moves entry i to the list its position and bound call for
+static void place(nearest_entry *entries, int *heads, int i) {
+    nearest_entry *e = &entries[i];
+    int b = buckets_x * buckets_y;
+
+    if (e->min_ring <= NEAREST_BUCKET) {
+        b = (e->pos.y / NEAREST_BUCKET) * buckets_x + e->pos.x / NEAREST_BUCKET;
+    }
+    if (b == e->bucket) {
+        return;
+    }
+    if (e->bucket >= 0) {
+        unlink_entry(entries, heads, i);
+    }
+    e->bucket = b;
+    e->prev = -1;
+    e->next = heads[b];
+    if (e->next >= 0) {
+        entries[e->next].prev = i;
+    }
+    heads[b] = i;
+}
+
+void nearest_init(Hunter *hunters, int hunter_count, Prey *preys, int prey_count,
+                  int map_width, int map_height) {
+    int i;
+
+    n_width = map_width;
+    n_height = map_height;
+    // get_state gives up before the farthest ring
+    no_adv = map_width + map_height - 2;
+
+    h_entries = calloc(hunter_count + 1, sizeof(nearest_entry));
+    p_entries = calloc(prey_count + 1, sizeof(nearest_entry));
+
+    buckets_x = (map_width + NEAREST_BUCKET - 1) / NEAREST_BUCKET;
+    buckets_y = (map_height + NEAREST_BUCKET - 1) / NEAREST_BUCKET;
+    h_heads = malloc((buckets_x * buckets_y + 1) * sizeof(int));
+    p_heads = malloc((buckets_x * buckets_y + 1) * sizeof(int));
+    for (i = 0; i <= buckets_x * buckets_y; ++i) {
+        h_heads[i] = -1;
+        p_heads[i] = -1;
+    }
+
+    for (i = 0; i < hunter_count; ++i) {
+        h_entries[i].pos = hunters[i].pos;
+        h_entries[i].min_ring = 1;
+        h_entries[i].bucket = -1;
+        place(h_entries, h_heads, i);
+    }
+    for (i = 0; i < prey_count; ++i) {
+        p_entries[i].pos = preys[i].pos;
+        p_entries[i].min_ring = 1;
+        p_entries[i].bucket = -1;
+        place(p_entries, p_heads, i);
+    }
+
+    enabled = 1;
+}
+
+static void check(nearest_entry *entries, int *heads, int i, int was, coordinate cell) {
+    nearest_entry *e = &entries[i];
+    int d;
+
+    if (was) {
+        // Lost the cached adversary, nothing closer appeared meanwhile
+        if (e->valid && e->adv_pos.x == cell.x && e->adv_pos.y == cell.y) {
+            e->valid = 0;
+        }
+        return;
+    }
+    // get_state never looks at the actor's own cell
+    if ((d = manhattan_dist(e->pos, cell)) == 0) {
+        return;
+    }
+    if (d <= e->dist) {
+        e->valid = 0;
+    }
+    if (d < e->min_ring) {
+        e->min_ring = d;
+        place(entries, heads, i);
+    }
+}
+
+static void invalidate(nearest_entry *entries, int *heads, actor_t a, coordinate cell,
+                       uint16_t old_encd, uint16_t new_encd) {
+    int i, next, bx, by;
+    int cx = cell.x / NEAREST_BUCKET, cy = cell.y / NEAREST_BUCKET;
+    int was = is_adversary(a, old_encd), is = is_adversary(a, new_encd);
+
+    if (was == is) {
+        return;
+    }
+
+    // An entry leaving the far list lands in the grid, where checking it again is harmless
+    for (i = heads[buckets_x * buckets_y]; i >= 0; i = next) {
+        next = entries[i].next;
+        check(entries, heads, i, was, cell);
+    }
+    for (by = cy - 1; by <= cy + 1; ++by) {
+        for (bx = cx - 1; bx <= cx + 1; ++bx) {
+            if (bx < 0 || by < 0 || bx >= buckets_x || by >= buckets_y) {
+                continue;
+            }
+            for (i = heads[by * buckets_x + bx]; i >= 0; i = entries[i].next) {
+                check(entries, heads, i, was, cell);
+            }
+        }
+    }
+}
+
+void nearest_cell(int x, int y, uint16_t old_encd, uint16_t new_encd) {
+    coordinate cell = { .x = x, .y = y };
+
+    if (!enabled || old_encd == new_encd) {
+        return;
+    }
+    invalidate(h_entries, h_heads, HUNTER, cell, old_encd, new_encd);
+    invalidate(p_entries, p_heads, PREY, cell, old_encd, new_encd);
+}
+
+void nearest_moved(actor_t a, int index, coordinate pos) {
+    nearest_entry *e;
+
+    if (!enabled) {
+        return;
+    }
+    e = (a == HUNTER) ? &h_entries[index] : &p_entries[index];
+
+    // One step changes every distance by at most one
+    e->pos = pos;
+    e->valid = 0;
+    if (e->min_ring > 1) {
+        e->min_ring--;
+    }
+    if (a == HUNTER) {
+        place(h_entries, h_heads, index);
+    } else {
+        place(p_entries, p_heads, index);
+    }
+}
+
+server_message nearest_state(uint16_t *map, actor_t a, int index, int x, int y,
+                             int map_width, int map_height) {
+    server_message state;
+    nearest_entry *e;
+    int ring;
+
+    if (!enabled) {
+        return kernel_state(map, a, x, y, map_width, map_height);
+    }
+    e = (a == HUNTER) ? &h_entries[index] : &p_entries[index];
+
+    if (!e->valid) {
+        e->adv_pos = e->pos;
+        ring = kernel_scan(map, a, e->pos.x, e->pos.y, n_width, n_height, e->min_ring, &e->adv_pos);
+        e->dist = ring ? ring : no_adv;
+        e->min_ring = e->dist;
+        e->valid = 1;
+        if (a == HUNTER) {
+            place(h_entries, h_heads, index);
+        } else {
+            place(p_entries, p_heads, index);
+        }
+    }
+
+    state.pos = e->pos;
+    state.adv_pos = e->adv_pos;
+    kernel_neighbours(map, a, &state, map_width, map_height);
+
+    return state;
+}
+
+void nearest_close(void) {
+    if (!enabled) {
+        return;
+    }
+    enabled = 0;
+    free(h_entries);
+    free(p_entries);
+    free(h_heads);
+    free(p_heads);
+}
@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "structs.h"
+#include "server.h"
+
+/*
+ * Pack coordination. Left alone every hunter chases the prey get_state calls
+ * closest, so packs pile onto one prey while others run free. Every N map
+ * updates, and whenever a prey dies, the coordinator assigns hunters to preys
+ * greedily: candidate hunter-prey pairs by increasing distance, each hunter
+ * takes the first prey that still has room, and a prey takes at most
+ * ceil(hunters / preys) hunters. A hunter's reply then carries its assigned
+ * prey as adv_pos; without an assignment it keeps get_state's answer.
+ *
+ * Preys are bucketed on a grid of PACK_BUCKET cells. A hunter's candidates
+ * are the preys of the bucket rings around it, grown until PACK_CANDIDATES
+ * preys are in, plus one more ring since a bucket ring only bounds the
+ * distance. A reassignment costs about H * PACK_CANDIDATES pairs instead of
+ * H * P; a hunter whose candidates are all full stays unassigned.
+ */
+
+#define PACK_BUCKET 8
+#define PACK_CANDIDATES 8
+
+typedef struct pack_pair {
+    int dist;
+    int hunter;
+    int prey;
+} pack_pair;
+
+static int every = 0;
+static int updates;
+static int h_count, p_count;
+static int *target;
+static int *load;
+static pack_pair *pairs;
+static size_t pairs_size;
+static Prey *p_actors;
+static int buckets_x, buckets_y;
+static int *bucket_head, *bucket_next;
+
+void pack_init(int n, Hunter *hunters, int hunter_count, Prey *preys, int prey_count,
+               int map_width, int map_height) {
+    every = n;
+    updates = 0;
+    h_count = hunter_count;
+    p_count = prey_count;
+    p_actors = preys;
+    buckets_x = (map_width + PACK_BUCKET - 1) / PACK_BUCKET;
+    buckets_y = (map_height + PACK_BUCKET - 1) / PACK_BUCKET;
+    target = malloc((hunter_count + 1) * sizeof(int));
+    load = malloc((prey_count + 1) * sizeof(int));
+    bucket_head = malloc(buckets_x * buckets_y * sizeof(int));
+    bucket_next = malloc((prey_count + 1) * sizeof(int));
+    pairs_size = (size_t)(hunter_count + 1) * PACK_CANDIDATES;
+    pairs = malloc(pairs_size * sizeof(pack_pair));
+    pack_assign(hunters, preys);
+}
+
+static int compare_pairs(const void *a, const void *b) {
+    const pack_pair *p = a, *q = b;
+
+    if (p->dist != q->dist) {
+        return p->dist - q->dist;
+    }
+    if (p->hunter != q->hunter) {
+        return p->hunter - q->hunter;
+    }
+    return p->prey - q->prey;
+}
+
+static void add_pair(size_t *n, int dist, int hunter, int prey) {
+    if (*n == pairs_size) {
+        pairs_size *= 2;
+        if ((pairs = realloc(pairs, pairs_size * sizeof(pack_pair))) == NULL) {
+            perror("Pack pairs error");
+            exit(1);
+        }
+    }
+    pairs[(*n)++] = (pack_pair){ dist, hunter, prey };
+}
+
+// Pairs hunter i with the preys of the bucket rings around it
+static void add_candidates(Hunter *hunter, int i, size_t *n) {
+    int cx = hunter->pos.x / PACK_BUCKET, cy = hunter->pos.y / PACK_BUCKET;
+    int r, bx, by, j, found = 0, last = -1;
+    int max_r = buckets_x > buckets_y ? buckets_x : buckets_y;
+
+    for (r = 0; r < max_r && (last < 0 || r <= last); ++r) {
+        for (by = cy - r; by <= cy + r; ++by) {
+            for (bx = cx - r; bx <= cx + r; ++bx) {
+                // Only the ring itself, the inside was done before
+                if (bx < 0 || by < 0 || bx >= buckets_x || by >= buckets_y
+                    || (by != cy - r && by != cy + r && bx != cx - r && bx != cx + r)) {
+                    continue;
+                }
+                for (j = bucket_head[by * buckets_x + bx]; j >= 0; j = bucket_next[j]) {
+                    add_pair(n, manhattan_dist(hunter->pos, p_actors[j].pos), i, j);
+                    found++;
+                }
+            }
+        }
+        if (last < 0 && found >= PACK_CANDIDATES) {
+            last = r + 1;
+        }
+    }
+}
+
+void pack_assign(Hunter *hunters, Prey *preys) {
+    int i, j, b, alive_h = 0, alive_p = 0, cap;
+    size_t k, n = 0;
+
+    if (every <= 0) {
+        return;
+    }
+
+    for (i = 0; i < h_count; ++i) {
+        target[i] = -1;
+        alive_h += hunters[i].alive;
+    }
+    for (b = 0; b < buckets_x * buckets_y; ++b) {
+        bucket_head[b] = -1;
+    }
+    for (j = 0; j < p_count; ++j) {
+        load[j] = 0;
+        if (preys[j].alive) {
+            alive_p++;
+            b = (preys[j].pos.y / PACK_BUCKET) * buckets_x + preys[j].pos.x / PACK_BUCKET;
+            bucket_next[j] = bucket_head[b];
+            bucket_head[b] = j;
+        }
+    }
+    if (alive_h == 0 || alive_p == 0) {
+        return;
+    }
+    cap = (alive_h + alive_p - 1) / alive_p;
+
+    for (i = 0; i < h_count; ++i) {
+        if (hunters[i].alive) {
+            add_candidates(&hunters[i], i, &n);
+        }
+    }
+    qsort(pairs, n, sizeof(pack_pair), compare_pairs);
+
+    for (k = 0; k < n; ++k) {
+        if (target[pairs[k].hunter] < 0 && load[pairs[k].prey] < cap) {
+            target[pairs[k].hunter] = pairs[k].prey;
+            load[pairs[k].prey]++;
+        }
+    }
+}
+
+void pack_update(Hunter *hunters, Prey *preys, int prey_died) {
+    if (every <= 0) {
+        return;
+    }
+    if (prey_died || ++updates >= every) {
+        updates = 0;
+        pack_assign(hunters, preys);
+    }
+}
+
+// The reply for a hunter, the state passed in is left as get_state made it
+server_message pack_target(int index, server_message state) {
+    int j;
+
+    if (every > 0 && (j = target[index]) >= 0 && p_actors[j].alive) {
+        state.adv_pos = p_actors[j].pos;
+    }
+    return state;
+}
+
+void pack_close(void) {
+    if (every <= 0) {
+        return;
+    }
+    every = 0;
+    free(target);
+    free(load);
+    free(pairs);
+    free(bucket_head);
+    free(bucket_next);
+}
@@ -0,0 +1,277 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "structs.h"
+#include "server.h"
+
+/*
+ * CPU placement of the server loop and the agents. Agents are numbered
+ * hunters first, then preys, and dealt round-robin over either a CPU list
+ * (one CPU each) or the NUMA nodes (the node's CPUs each). Co-location keeps
+ * the agents on the server's node, off the server's own CPU when possible.
+ *
+ * In distributed mode tile i runs on the i-th online CPU from the server's
+ * on, wrapping around; the coordinator keeps the server's CPU, which it
+ * shares with tile 0 since it mostly waits for reports.
+ */
+
+#define MAX_NODES 64
+
+static int enabled = 0;
+static int server_cpu = -1;
+static int agent_cpus[CPU_SETSIZE];
+static int agent_cpu_count = 0;
+static cpu_set_t online_cpus;
+static cpu_set_t nodes[MAX_NODES];
+static int node_count = 0;
+static int spread_nodes = 0;
+
+static int parse_cpu_list(const char *list, cpu_set_t *set) {
+    const char *p = list;
+    char *end;
+    long lo, hi;
+
+    CPU_ZERO(set);
+    while (*p != '\0' && *p != '\n') {
+        lo = strtol(p, &end, 10);
+        if (end == p || lo < 0) {
+            return -1;
+        }
+        hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+            if (end == p || hi < lo) {
+                return -1;
+            }
+        }
+        for (; lo <= hi && lo < CPU_SETSIZE; ++lo) {
+            CPU_SET(lo, set);
+        }
+        p = (*end == ',') ? end + 1 : end;
+        if (end == p && *p != '\0' && *p != '\n') {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void format_cpu_set(cpu_set_t *set, char *buf, size_t size) {
+    int cpu, start = -1;
+    size_t len = 0;
+
+    buf[0] = '\0';
+    for (cpu = 0; cpu <= CPU_SETSIZE; ++cpu) {
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, set)) {
+            if (start < 0) {
+                start = cpu;
+            }
+        } else if (start >= 0) {
+            if (len < size) {
+                len += snprintf(buf + len, size - len, "%s%d", len ? "," : "", start);
+            }
+            if (cpu - 1 > start && len < size) {
+                len += snprintf(buf + len, size - len, "-%d", cpu - 1);
+            }
+            start = -1;
+        }
+    }
+}
+
+// Online CPUs from sysfs, or the CPUs we may run on
+static void load_online(cpu_set_t *online) {
+    char line[4096];
+    FILE *f;
+
+    if ((f = fopen("/sys/devices/system/cpu/online", "r")) != NULL) {
+        if (fgets(line, sizeof line, f) != NULL && parse_cpu_list(line, online) == 0
+            && CPU_COUNT(online) > 0) {
+            fclose(f);
+            return;
+        }
+        fclose(f);
+    }
+    sched_getaffinity(0, sizeof(cpu_set_t), online);
+}
+
+// NUMA nodes from sysfs, or a single node with every online CPU
+static void load_nodes(void) {
+    char path[128], line[4096];
+    FILE *f;
+    int n;
+
+    for (n = 0; n < MAX_NODES; ++n) {
+        snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", n);
+        if ((f = fopen(path, "r")) == NULL) {
+            break;
+        }
+        if (fgets(line, sizeof line, f) != NULL && parse_cpu_list(line, &nodes[node_count]) == 0
+            && CPU_COUNT(&nodes[node_count]) > 0) {
+            node_count++;
+        }
+        fclose(f);
+    }
+
+    if (node_count == 0) {
+        sched_getaffinity(0, sizeof(cpu_set_t), &nodes[0]);
+        node_count = 1;
+    }
+}
+
+static int node_of_cpu(int cpu) {
+    int n;
+
+    for (n = 0; n < node_count; ++n) {
+        if (CPU_ISSET(cpu, &nodes[n])) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+int placement_init(int cpu, const char *agent_list, int numa_spread, int colocate) {
+    cpu_set_t set, online, extra;
+    int i, node;
+
+    load_nodes();
+    load_online(&online);
+    online_cpus = online;
+    server_cpu = cpu;
+    spread_nodes = numa_spread;
+
+    // sched_setaffinity would fail later with nobody to tell, refuse offline CPUs here
+    if (server_cpu >= CPU_SETSIZE || (server_cpu >= 0 && !CPU_ISSET(server_cpu, &online))) {
+        return -1;
+    }
+
+    if (agent_list != NULL) {
+        if (parse_cpu_list(agent_list, &set) < 0 || CPU_COUNT(&set) == 0) {
+            return -1;
+        }
+        CPU_XOR(&extra, &set, &online);
+        CPU_AND(&extra, &extra, &set);
+        if (CPU_COUNT(&extra) > 0) {
+            return -1;
+        }
+    } else {
+        CPU_ZERO(&set);
+    }
+
+    // Co-location narrows the agents to the server's node
+    if (colocate) {
+        if (server_cpu < 0 || (node = node_of_cpu(server_cpu)) < 0) {
+            return -1;
+        }
+        if (agent_list != NULL) {
+            CPU_AND(&set, &set, &nodes[node]);
+        } else {
+            CPU_OR(&set, &set, &nodes[node]);
+        }
+        if (CPU_COUNT(&set) > 1) {
+            CPU_CLR(server_cpu, &set);
+        }
+        spread_nodes = 0;
+    }
+
+    for (i = 0; i < CPU_SETSIZE; ++i) {
+        if (CPU_ISSET(i, &set)) {
+            agent_cpus[agent_cpu_count++] = i;
+        }
+    }
+
+    enabled = server_cpu >= 0 || agent_cpu_count > 0 || spread_nodes;
+    return 0;
+}
+
+// Pins agent pid, 0 for the calling process. The server pins every agent it
+// forks so placement_report never sees a child that has not run yet; the
+// agent pins itself too before exec, the mask survives the exec. The CPUs
+// were checked in placement_init.
+void placement_apply_agent(pid_t pid, int ordinal) {
+    cpu_set_t set;
+
+    if (agent_cpu_count > 0) {
+        CPU_ZERO(&set);
+        CPU_SET(agent_cpus[ordinal % agent_cpu_count], &set);
+    } else if (spread_nodes) {
+        set = nodes[ordinal % node_count];
+    } else {
+        return;
+    }
+    if (sched_setaffinity(pid, sizeof(cpu_set_t), &set) < 0) {
+        perror("Agent affinity error");
+    }
+}
+
+// Pins only the calling thread, helper threads started earlier keep floating
+void placement_apply_server(void) {
+    cpu_set_t set;
+
+    if (server_cpu < 0) {
+        return;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(server_cpu, &set);
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &set) < 0) {
+        perror("Server affinity error");
+    }
+}
+
+// Runs in the forked tile, after its helper threads are started
+void placement_apply_tile(int id) {
+    cpu_set_t set;
+    int cpu = server_cpu, step = id % CPU_COUNT(&online_cpus);
+
+    if (server_cpu < 0) {
+        return;
+    }
+    while (step > 0) {
+        cpu = (cpu + 1) % CPU_SETSIZE;
+        step -= CPU_ISSET(cpu, &online_cpus) ? 1 : 0;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &set) < 0) {
+        perror("Tile affinity error");
+    }
+}
+
+void placement_report_tile(FILE *out, int id, pid_t pid) {
+    cpu_set_t set;
+    char buf[1024];
+
+    if (!enabled || sched_getaffinity(pid, sizeof(cpu_set_t), &set) < 0) {
+        return;
+    }
+    format_cpu_set(&set, buf, sizeof buf);
+    fprintf(out, "placement: tile %d (pid %d) cpus %s\n", id, pid, buf);
+}
+
+void placement_report(FILE *out, Hunter *hunters, int hunter_count, Prey *preys, int prey_count) {
+    cpu_set_t set;
+    char buf[1024];
+    int i;
+
+    if (!enabled) {
+        return;
+    }
+
+    sched_getaffinity(0, sizeof(cpu_set_t), &set);
+    format_cpu_set(&set, buf, sizeof buf);
+    fprintf(out, "placement: server cpus %s, %d numa node(s)\n", buf, node_count);
+
+    for (i = 0; i < hunter_count + prey_count; ++i) {
+        pid_t pid = (i < hunter_count) ? hunters[i].pid : preys[i - hunter_count].pid;
+        if (sched_getaffinity(pid, sizeof(cpu_set_t), &set) < 0) {
+            continue;
+        }
+        format_cpu_set(&set, buf, sizeof buf);
+        fprintf(out, "placement: %s %d (pid %d) cpus %s\n", (i < hunter_count) ? "hunter" : "prey",
+                (i < hunter_count) ? i : i - hunter_count, pid, buf);
+    }
+}
@@ -7,15 +7,18 @@
 #include <sys/types.h>
 #include <stdint.h>
 #include "structs.h"
+#include "framing.h"
 
 int manhattan_dist(coordinate pos1, coordinate pos2) {
     return abs(pos1.x - pos2.x) + abs(pos1.y - pos2.y);
 }
 
 
+// Up, right, down, left: the order ties are broken in
+static const coordinate steps[4] = { {0, -1}, {1, 0}, {0, 1}, {-1, 0} };
+
 ph_message get_possible_move(server_message curr_state, int map_width, int map_height) {
-    int i, candidate_dist;
-    int available_dirs[4] = {1, 1, 1, 1};
+    int i, j, candidate_dist;
     coordinate candidate_pos;
     coordinate curr_pos = curr_state.pos;
     coordinate adv_pos = curr_state.adv_pos;
@@ -24,88 +27,34 @@ ph_message get_possible_move(server_message curr_state, int map_width, int map_h
 
     ph_message request;
 
-    // Mark unavailable directions
-
-    if (curr_pos.x - 1 < 0) {
-        available_dirs[3] = 0;
-    }
-    if (curr_pos.x + 1 >= map_width) {
-        available_dirs[1] = 0;
-    }
-    if (curr_pos.y - 1 < 0) {
-        available_dirs[0] = 0;
-    }
-    if (curr_pos.y + 1 >= map_height) {
-        available_dirs[2] = 0;
-    }
+    for (i = 0; i < 4; ++i) {
+        candidate_pos.x = curr_pos.x + steps[i].x;
+        candidate_pos.y = curr_pos.y + steps[i].y;
 
-    for (i = 0; i < curr_state.object_count; ++i) {
-        if (curr_state.object_pos[i].x == curr_pos.x) {
-            if (curr_state.object_pos[i].y < curr_pos.y) {
-                available_dirs[0] = 0;
-                
-            } else if(curr_state.object_pos[i].y > curr_pos.y) {
-                available_dirs[2] = 0;
-            }
-        } else if (curr_state.object_pos[i].y == curr_pos.y) {
-            if (curr_state.object_pos[i].x < curr_pos.x) {
-                available_dirs[3] = 0;
-            } else if(curr_state.object_pos[i].x > curr_pos.x) {
-                available_dirs[1] = 0;
+        // Off the map
+        if (candidate_pos.x < 0 || candidate_pos.y < 0
+            || candidate_pos.x >= map_width || candidate_pos.y >= map_height) {
+            continue;
+        }
+        // Taken by a neighbour the server reported
+        for (j = 0; j < curr_state.object_count; ++j) {
+            if (curr_state.object_pos[j].x == candidate_pos.x && curr_state.object_pos[j].y == candidate_pos.y) {
+                break;
             }
         }
-    }
-
-    
+        if (j < curr_state.object_count) {
+            continue;
+        }
 
-    // Choose from available directions
-    for (i = 0; i < 4; ++i) {
-        if (available_dirs[i] != 0) {
-            switch (i) {
-                case 0:
-                    candidate_pos.x = curr_pos.x;
-                    candidate_pos.y = curr_pos.y - 1;
-                    candidate_dist = manhattan_dist(adv_pos, candidate_pos);
-                    if (candidate_dist > max_dist) {
-                        max_dist = candidate_dist;
-                        max_pos = candidate_pos;
-                    }
-                    break;
-                case 1:
-                    candidate_pos.x = curr_pos.x + 1;
-                    candidate_pos.y = curr_pos.y;
-                    candidate_dist = manhattan_dist(adv_pos, candidate_pos);
-                    if (candidate_dist > max_dist) {
-                        max_dist = candidate_dist;
-                        max_pos = candidate_pos;
-                    }   
-                    break;
-                case 2:
-                    candidate_pos.x = curr_pos.x;
-                    candidate_pos.y = curr_pos.y + 1;
-                    candidate_dist = manhattan_dist(adv_pos, candidate_pos);
-                    if (candidate_dist > max_dist) {
-                        max_dist = candidate_dist;
-                        max_pos = candidate_pos;
-                    }   
-                    break;
-                case 3:
-                    candidate_pos.x = curr_pos.x - 1;
-                    candidate_pos.y = curr_pos.y;
-                    candidate_dist = manhattan_dist(adv_pos, candidate_pos);
-                    if (candidate_dist > max_dist) {
-                        max_dist = candidate_dist;
-                        max_pos = candidate_pos;
-                    }   
-                    break;
-            }
+        candidate_dist = manhattan_dist(adv_pos, candidate_pos);
+        if (candidate_dist > max_dist) {
+            max_dist = candidate_dist;
+            max_pos = candidate_pos;
         }
     }
 
     request.move_request = max_pos;
 
-    /* fprintf(stderr, "Prey(%d) was at (%d, %d), adv_pos was (%d,%d) and proposed (%d, %d), directions: %d%d%d%d\n", 
-            getpid(), curr_pos.x, curr_pos.y, curr_state.adv_pos.x, curr_state.adv_pos.y, max_pos.x, max_pos.y, available_dirs[0], available_dirs[1],available_dirs[2],available_dirs[3]); */
     return request;
 }
 
@@ -115,6 +64,7 @@ int main(int argc, char **argv) {
     server_message last_state;
     ph_message request;
     pid_t pid = getpid();
+    frame_reader reader;
 
     // Read map width and height
     map_width = atoi(argv[1]);
@@ -122,15 +72,19 @@ int main(int argc, char **argv) {
 
 
 
+    frame_reader_init(&reader, sizeof(server_message));
+
     while (1) {
-        // Get state information
-        read(0, &last_state, sizeof(server_message));
+        // Get state information, skip any stale ones queued behind it
+        if (frame_read_latest(0, &reader, &last_state, 1) < 0) {
+            exit(0);
+        }
 
         // Generate request
         request = get_possible_move(last_state, map_width, map_height);
 
         // Send request
-        write(1, &request, sizeof(ph_message));
+        write_frame(1, &request, sizeof(ph_message));
 
         // Sleep for a random time
         usleep(10000*(1+rand()%9));
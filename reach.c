@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "structs.h"
+#include "server.h"
+
+/*
+ * Connected components of free space (every cell that is not an OBSTACLE,
+ * 4-neighbourhood). Obstacles never move, so the labels are computed once at
+ * load; only the actors standing in each component change over the game.
+ */
+int *label_components(uint16_t *map, int map_width, int map_height, int *component_count) {
+    int i, cell, x, y, top, count = 0;
+    int size = map_width * map_height;
+    int *labels = malloc(size * sizeof(int));
+    int *stack = malloc(size * sizeof(int));
+    int dx[4] = {0, 1, 0, -1};
+    int dy[4] = {-1, 0, 1, 0};
+
+    for (cell = 0; cell < size; ++cell) {
+        labels[cell] = -1;
+    }
+
+    for (cell = 0; cell < size; ++cell) {
+        if (labels[cell] >= 0 || decode_actor(map[cell]) == OBSTACLE) {
+            continue;
+        }
+
+        // Flood fill a new component
+        labels[cell] = count;
+        stack[0] = cell;
+        top = 1;
+        while (top > 0) {
+            top--;
+            x = stack[top] % map_width;
+            y = stack[top] / map_width;
+            for (i = 0; i < 4; ++i) {
+                if (x + dx[i] < 0 || x + dx[i] >= map_width || y + dy[i] < 0 || y + dy[i] >= map_height) {
+                    continue;
+                }
+                int next = get1D(x + dx[i], y + dy[i], map_width);
+                if (labels[next] < 0 && decode_actor(map[next]) != OBSTACLE) {
+                    labels[next] = count;
+                    stack[top++] = next;
+                }
+            }
+        }
+        count++;
+    }
+
+    free(stack);
+    *component_count = count;
+    return labels;
+}
+
+// Returns 1 if some component holds both a hunter and a prey
+int preys_reachable(int *labels, int component_count, uint16_t *map, int map_width, int map_height) {
+    int cell, reachable = 0;
+    uint8_t *seen = calloc(component_count + 1, sizeof(uint8_t));
+
+    for (cell = 0; cell < map_width * map_height && !reachable; ++cell) {
+        switch (decode_actor(map[cell])) {
+            case HUNTER:
+                seen[labels[cell]] |= 1;
+                break;
+            case PREY:
+                seen[labels[cell]] |= 2;
+                break;
+            case DOUBLE:
+                seen[labels[cell]] |= 3;
+                break;
+            default:
+                continue;
+        }
+        reachable = (seen[labels[cell]] == 3);
+    }
+
+    free(seen);
+    return reachable;
+}
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include "structs.h"
+#include "server.h"
+
+/*
+ * Renderer: the simulation publishes the map once per tick into one of two
+ * snapshot buffers guarded by a sequence counter (seqlock), then flips the
+ * current index. Spectator threads copy the current snapshot out at their own
+ * frame rate and retry if the writer lapped them, so the simulation never
+ * waits for a spectator however slow its output is.
+ */
+
+#define MAX_SPECTATORS 8
+#define DEFAULT_FPS 10
+
+typedef struct spectator {
+    FILE *out;
+    int fps;
+    pthread_t thread;
+} spectator;
+
+static spectator spectators[MAX_SPECTATORS];
+static int spectator_count = 0;
+
+static int r_width, r_height;
+static size_t snapshot_size;
+static uint16_t *snapshots[2];
+static atomic_uint seq[2];
+static atomic_int current;
+static atomic_ulong frame;
+static atomic_int running;
+
+int render_add_spectator(const char *spec) {
+    char buf[256];
+    char *path, *fps;
+    spectator *s;
+
+    if (spectator_count == MAX_SPECTATORS) {
+        return -1;
+    }
+    s = &spectators[spectator_count];
+
+    snprintf(buf, sizeof buf, "%s", spec);
+    s->fps = DEFAULT_FPS;
+
+    if (strncmp(buf, "term", 4) == 0 && (buf[4] == '\0' || buf[4] == ':')) {
+        s->out = stdout;
+        fps = (buf[4] == ':') ? buf + 5 : NULL;
+    } else if (strncmp(buf, "file:", 5) == 0) {
+        path = buf + 5;
+        if ((fps = strrchr(path, ':')) != NULL) {
+            *fps++ = '\0';
+        }
+        if ((s->out = fopen(path, "w")) == NULL) {
+            perror("Spectator file error");
+            return -1;
+        }
+    } else {
+        return -1;
+    }
+
+    // 0 fps polls every millisecond and draws each new frame it sees
+    if (fps != NULL && (s->fps = atoi(fps)) < 0) {
+        return -1;
+    }
+
+    spectator_count++;
+    return 0;
+}
+
+void render_init(int map_width, int map_height) {
+    r_width = map_width;
+    r_height = map_height;
+    snapshot_size = map_width * map_height * sizeof(uint16_t);
+
+    if (spectator_count > 0) {
+        snapshots[0] = calloc(1, snapshot_size);
+        snapshots[1] = calloc(1, snapshot_size);
+    }
+}
+
+void render_frame(uint16_t *map, int map_width, int map_height) {
+    int b;
+    unsigned s;
+
+    // Without spectators the map is printed inline like before
+    if (spectator_count == 0) {
+        print_map(map, map_width, map_height);
+        return;
+    }
+
+    b = 1 - atomic_load_explicit(&current, memory_order_relaxed);
+    s = atomic_load_explicit(&seq[b], memory_order_relaxed);
+
+    atomic_store_explicit(&seq[b], s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(snapshots[b], map, snapshot_size);
+    atomic_store_explicit(&seq[b], s + 2, memory_order_release);
+
+    atomic_store_explicit(&current, b, memory_order_release);
+    atomic_fetch_add_explicit(&frame, 1, memory_order_release);
+}
+
+static void read_snapshot(uint16_t *dst) {
+    int b;
+    unsigned s1, s2;
+
+    do {
+        b = atomic_load_explicit(&current, memory_order_acquire);
+        s1 = atomic_load_explicit(&seq[b], memory_order_acquire);
+        if (s1 & 1) {
+            continue;
+        }
+        memcpy(dst, snapshots[b], snapshot_size);
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&seq[b], memory_order_relaxed);
+    } while ((s1 & 1) || s1 != s2);
+}
+
+static void *spectator_loop(void *arg) {
+    spectator *s = arg;
+    uint16_t *map = malloc(snapshot_size);
+    unsigned long seen = 0, published;
+    int stopping;
+    struct timespec period;
+
+    if (s->fps > 0) {
+        period.tv_sec = 0;
+        period.tv_nsec = 1000000000L / s->fps;
+        if (s->fps == 1) {
+            period.tv_sec = 1;
+            period.tv_nsec = 0;
+        }
+    } else {
+        period.tv_sec = 0;
+        period.tv_nsec = 1000000L;
+    }
+
+    do {
+        stopping = !atomic_load_explicit(&running, memory_order_acquire);
+        published = atomic_load_explicit(&frame, memory_order_acquire);
+
+        // Skip ticks we slept through, only the latest frame is drawn
+        if (published != seen) {
+            read_snapshot(map);
+            fprint_map(s->out, map, r_width, r_height);
+            fflush(s->out);
+            seen = published;
+        }
+
+        if (!stopping) {
+            nanosleep(&period, NULL);
+        }
+    } while (!stopping);
+
+    free(map);
+    return NULL;
+}
+
+void render_start(void) {
+    int i;
+
+    atomic_store(&running, 1);
+    for (i = 0; i < spectator_count; ++i) {
+        if (pthread_create(&spectators[i].thread, NULL, spectator_loop, &spectators[i]) != 0) {
+            perror("Spectator thread error");
+            exit(1);
+        }
+    }
+}
+
+void render_stop(void) {
+    int i;
+
+    // Spectators draw the final frame before they leave
+    atomic_store(&running, 0);
+    for (i = 0; i < spectator_count; ++i) {
+        pthread_join(spectators[i].thread, NULL);
+        if (spectators[i].out != stdout) {
+            fclose(spectators[i].out);
+        }
+    }
+
+    free(snapshots[0]);
+    free(snapshots[1]);
+}
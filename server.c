@@ -10,14 +10,15 @@
 #include <sys/types.h>
 #include <stdint.h>
 #include "structs.h"
-
-#define PIPE(fd) socketpair(AF_UNIX, SOCK_STREAM, 0, fd)
-
-server_message get_state(uint16_t *map, actor_t a, int x, int y, int map_width, int map_height);
-void move_actor(uint16_t *map, int x, int y, int new_x, int new_y, actor_t a, int map_width);
+#include "server.h"
+#include "framing.h"
 
 int get1D(int x, int y, int width) { return y * width + x; }
 
+int manhattan_dist(coordinate pos1, coordinate pos2) {
+    return abs(pos1.x - pos2.x) + abs(pos1.y - pos2.y);
+}
+
 uint16_t encode_actor(actor_t a, int index) {
     uint16_t encd = a | (index << 3);
 
@@ -32,49 +33,53 @@ uint16_t decode_index(uint16_t encd) {
     return encd >> 3;
 }
 
-void print_map(uint16_t *map, int map_width, int map_height) {
+void fprint_map(FILE *out, uint16_t *map, int map_width, int map_height) {
     int i, j;
     
     // Print top numbers
-    /* printf(" +");
-    for (i = 0; i < map_width; ++i) { printf("%d", i); }
-    printf("+\n"); */
+    /* fprintf(out, " +");
+    for (i = 0; i < map_width; ++i) { fprintf(out, "%d", i); }
+    fprintf(out, "+\n"); */
 
     // Print top dashes
-    printf("+");
-    for (i = 0; i < map_width; ++i) { printf("-"); }
-    printf("+\n");
+    fprintf(out, "+");
+    for (i = 0; i < map_width; ++i) { fprintf(out, "-"); }
+    fprintf(out, "+\n");
 
     // Print hunters, preys, obstacles
     for (i = 0; i < map_height; i++) {
-        // printf("%d|", i);
-        printf("|");
+        // fprintf(out, "%d|", i);
+        fprintf(out, "|");
         for (j = 0; j < map_width; j++) {
             switch(decode_actor(map[get1D(j, i, map_width)])) {
                 case HUNTER:
-                    printf("H");
+                    fprintf(out, "H");
                     break;
                 case PREY:
-                    printf("P");
+                    fprintf(out, "P");
                     break;
                 case OBSTACLE:
-                    printf("X");
+                    fprintf(out, "X");
                     break;
                 case DOUBLE:
-                    printf("D");
+                    fprintf(out, "D");
                     break;
                 case EMPTY:
-                    printf(" ");
+                    fprintf(out, " ");
                     break;
             }
         }
-        printf("|\n");
+        fprintf(out, "|\n");
     }
 
     // Print bottom dashes
-    printf("+");
-    for (i = 0; i < map_width; ++i) { printf("-"); }
-    printf("+\n");
+    fprintf(out, "+");
+    for (i = 0; i < map_width; ++i) { fprintf(out, "-"); }
+    fprintf(out, "+\n");
+}
+
+void print_map(uint16_t *map, int map_width, int map_height) {
+    fprint_map(stdout, map, map_width, map_height);
 }
 
 void initialize_map(uint16_t *map, int map_width, Hunter *hunters, int hunter_count,
@@ -94,6 +99,18 @@ void initialize_map(uint16_t *map, int map_width, Hunter *hunters, int hunter_co
     }
 }
 
+// Actors without a process (pid <= 0, as in the harness) are only marked dead;
+// kill() on 0 or -1 would hit the whole process group or everything
+void end_agent(pid_t pid, int fd) {
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (pid > 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+}
+
 void update_map(uint16_t *map, int map_width, Hunter *hunters, int hunter_count,
                 Prey *preys, int prey_count, int *alive_prey_count, int *alive_hunter_count,
                 int h_pipes[][2], int p_pipes[][2], struct pollfd *pfd_h, struct pollfd *pfd_p) {
@@ -109,14 +126,11 @@ void update_map(uint16_t *map, int map_width, Hunter *hunters, int hunter_count,
                 // Transfer its energy to the hunter and set it dead
                 preys[kill_prey_idx].alive = 0;
                 hunters[i].energy += preys[kill_prey_idx].stored_energy;
-                // Close corresponding pipe
-                close(p_pipes[kill_prey_idx][0]);
-                // Send SIGTERM to the corresponding pid
-                kill(preys[kill_prey_idx].pid, SIGTERM);
-                // Reap
-                waitpid(preys[kill_prey_idx].pid, NULL, 0);
+                // Close its pipe, terminate and reap it
+                end_agent(preys[kill_prey_idx].pid, p_pipes[kill_prey_idx][0]);
                 // Decrease alive prey count
                 (*alive_prey_count)--;
+                telemetry_death(PREY, kill_prey_idx, preys[kill_prey_idx].pos, preys[kill_prey_idx].stored_energy);
                 // Set revent flag of prey in pfd
                 pfd_p[kill_prey_idx].fd = -1;
                 // printf("KILL THE PREY AT %d (%d, %d)\n", kill_prey_idx, preys[kill_prey_idx].pos.x, preys[kill_prey_idx].pos.y);
@@ -125,14 +139,11 @@ void update_map(uint16_t *map, int map_width, Hunter *hunters, int hunter_count,
             if (hunters[i].energy <= 0) {
                 // Kill hunter
                 hunters[i].alive = 0;
-                // Close corresponding pipe
-                close(h_pipes[i][0]);
-                // Send SIGTERM to the corresponding pid
-                kill(hunters[i].pid, SIGTERM);
-                // Reap
-                waitpid(hunters[i].pid, NULL, 0);
+                // Close its pipe, terminate and reap it
+                end_agent(hunters[i].pid, h_pipes[i][0]);
                 // Decrease alive hunter count
                 (*alive_hunter_count)--;
+                telemetry_death(HUNTER, i, hunters[i].pos, hunters[i].energy);
                 // Set revent flag of hunter in pfd
                 pfd_h[i].fd = -1;
             }
@@ -142,6 +153,8 @@ void update_map(uint16_t *map, int map_width, Hunter *hunters, int hunter_count,
             } else {
                 map[get1D(hunters[i].pos.x, hunters[i].pos.y, map_width)] = EMPTY;
             }
+            nearest_cell(hunters[i].pos.x, hunters[i].pos.y, curr_encd,
+                         map[get1D(hunters[i].pos.x, hunters[i].pos.y, map_width)]);
         }
     }
 }
@@ -168,6 +181,7 @@ void setup_children(Hunter *hunters, int hunter_count, int h_pipes[][2], Prey *p
         } else if (pid > 0) { /* Server */
             // Close child end
             hunters[i].pid = pid;
+            placement_apply_agent(pid, i);
         } else { /* New Hunter Process*/
             // Close parent end
             close(h_pipes[i][0]);
@@ -179,6 +193,9 @@ void setup_children(Hunter *hunters, int hunter_count, int h_pipes[][2], Prey *p
                 }
             }
             
+            // Pin before exec, the mask survives it
+            placement_apply_agent(0, i);
+
             // Redirect stdin and stdout to pipe
             dup2(h_pipes[i][1], 1);
             dup2(h_pipes[i][1], 0);
@@ -209,6 +226,7 @@ void setup_children(Hunter *hunters, int hunter_count, int h_pipes[][2], Prey *p
         } else if (pid > 0) { /* Server */
             // Close child end
             preys[i].pid = pid;
+            placement_apply_agent(pid, hunter_count + i);
         } else { /* New Hunter Process*/
             // Close parent end
             close(p_pipes[i][0]);
@@ -227,6 +245,9 @@ void setup_children(Hunter *hunters, int hunter_count, int h_pipes[][2], Prey *p
                 close(h_pipes[j][1]);
             }
 
+            // Pin before exec, the mask survives it
+            placement_apply_agent(0, hunter_count + i);
+
             // Redirect stdin and stdout to pipe
             dup2(p_pipes[i][1], 1);
             dup2(p_pipes[i][1], 0);
@@ -253,32 +274,43 @@ void setup_children(Hunter *hunters, int hunter_count, int h_pipes[][2], Prey *p
 
     for (i = 0; i < hunter_count; ++i) {
         state = get_state(map, HUNTER, hunters[i].pos.x, hunters[i].pos.y, map_width, map_height);
-        write(h_pipes[i][0], &state, sizeof(server_message));
+        write_frame(h_pipes[i][0], &state, sizeof(server_message));
     }
 
     for (i = 0; i < prey_count; ++i) {
         state = get_state(map, PREY, preys[i].pos.x, preys[i].pos.y, map_width, map_height);
-        write(p_pipes[i][0], &state, sizeof(server_message));
+        write_frame(p_pipes[i][0], &state, sizeof(server_message));
     }
 }
 
 server_message get_state(uint16_t *map, actor_t a, int x, int y, int map_width, int map_height) {
-    
-    int i, j, k, l, offset_x, offset_y;
-    uint8_t adv_found;
-    int coeffs[2] = {-1, 1};
     server_message state;
 
-    adv_found = 0;
-
     // Set position of state
     state.pos = (coordinate) {
         .x = x,
         .y = y,
     };
 
-    // Found closest adversary
-    for (i = 1; i < (map_height+map_width-2); ++i) {
+    // No adversary left on the map leaves adv_pos on the actor itself
+    state.adv_pos = state.pos;
+
+    scan_adversary(map, a, x, y, map_width, map_height, 1, &state.adv_pos);
+    scan_neighbours(map, a, &state, map_width, map_height);
+
+    return state;
+}
+
+int scan_adversary(uint16_t *map, actor_t a, int x, int y, int map_width, int map_height,
+                   int start_ring, coordinate *adv_pos) {
+    int i, j, k, l;
+    uint8_t adv_found;
+    int coeffs[2] = {-1, 1};
+
+    adv_found = 0;
+
+    // Found closest adversary, rings below start_ring are known to be empty of them
+    for (i = start_ring; i < (map_height+map_width-2); ++i) {
         for (j = 0; j <= i; ++j) {
             for (k = 0; k < 2; ++k) {
                 for (l = 0; l < 2; ++l) {
@@ -290,8 +322,8 @@ server_message get_state(uint16_t *map, actor_t a, int x, int y, int map_width,
                         || (a == PREY && (decode_actor(map[get1D(x+coeffs[k]*j, y+coeffs[l]*(i-j), map_width)]) == HUNTER))
                         || (a == PREY && (decode_actor(map[get1D(x+coeffs[k]*j, y+coeffs[l]*(i-j), map_width)]) == DOUBLE))) {
                             adv_found = 1;
-                            state.adv_pos.x = x+coeffs[k]*j;
-                            state.adv_pos.y = y+coeffs[l]*(i-j);
+                            adv_pos->x = x+coeffs[k]*j;
+                            adv_pos->y = y+coeffs[l]*(i-j);
                             break;
                         }
                     }
@@ -305,12 +337,20 @@ server_message get_state(uint16_t *map, actor_t a, int x, int y, int map_width,
             }
         }
         if (adv_found){
-            break;
+            return i;
         }
     }
+
+    return 0;
+}
+
+void scan_neighbours(uint16_t *map, actor_t a, server_message *state, int map_width, int map_height) {
+    int i, j, offset_x, offset_y;
+    int x = state->pos.x, y = state->pos.y;
+
     // Find neighbours
     // Reset neighbour count
-    state.object_count = 0;
+    state->object_count = 0;
 
     for (i = -1; i < 2; ++i) {
         for (j = -1; j < 2; ++j) {
@@ -331,18 +371,16 @@ server_message get_state(uint16_t *map, actor_t a, int x, int y, int map_width,
                     continue;
                 } else if ((a == HUNTER && (decode_actor(map[get1D(x+offset_x, y+offset_y, map_width)]) != PREY))
                        || (a == PREY && (decode_actor(map[get1D(x+offset_x, y+offset_y, map_width)]) != HUNTER))) {
-                    state.object_pos[state.object_count] = (coordinate){
+                    state->object_pos[state->object_count] = (coordinate){
                         .x = x + offset_x,
                         .y = y + offset_y,
                     };
-                    state.object_count += 1;
+                    state->object_count += 1;
                     break;
                 }
             }
         }
     }
-
-    return state;
 }
 
 uint8_t handle_request(ph_message request, uint16_t *map, Hunter *hunters, 
@@ -350,6 +388,8 @@ uint8_t handle_request(ph_message request, uint16_t *map, Hunter *hunters,
     
     uint16_t requested_location = map[get1D(request.move_request.x, request.move_request.y, map_width)];
     uint8_t accepted = 0;
+    coordinate from = (a == HUNTER) ? hunters[index].pos : preys[index].pos;
+    uint16_t from_encd = map[get1D(from.x, from.y, map_width)];
 
     switch (decode_actor(requested_location)) {
         case HUNTER:
@@ -382,6 +422,14 @@ uint8_t handle_request(ph_message request, uint16_t *map, Hunter *hunters,
         preys[index].pos = request.move_request;
     }
 
+    // Let the nearest-adversary cache see both changed cells
+    if (accepted) {
+        nearest_cell(from.x, from.y, from_encd, map[get1D(from.x, from.y, map_width)]);
+        nearest_cell(request.move_request.x, request.move_request.y, requested_location,
+                     map[get1D(request.move_request.x, request.move_request.y, map_width)]);
+        nearest_moved(a, index, request.move_request);
+    }
+
     return accepted;
 }
 
@@ -430,33 +478,90 @@ void kill_remaining(Hunter *hunters, Prey *preys, int hunter_count, int prey_cou
     if (alive_hunter_count > 0) {
         for (i = 0; i < hunter_count; ++i) {
             if (hunters[i].alive) {
-                // Close corresponding pipe
-                close(h_pipes[i][0]);
-                // Kill corresponding process
-                kill(hunters[i].pid, SIGTERM);
-                // Reap it
-                waitpid(hunters[i].pid, NULL, 0);
+                end_agent(hunters[i].pid, h_pipes[i][0]);
             }
         }
-    } else if (alive_prey_count > 0) {
+    }
+    // If Preys won, or both sides are left after a stalemate
+    if (alive_prey_count > 0) {
         for (i = 0; i < prey_count; ++i) {
             if (preys[i].alive) {
-                // Close corresponding pipe
-                close(p_pipes[i][0]);
-                // Kill corresponding process
-                kill(preys[i].pid, SIGTERM);
-                // Reap it
-                waitpid(preys[i].pid, NULL, 0);
+                end_agent(preys[i].pid, p_pipes[i][0]);
             }
         }
     }
 }
 
+// The harness links the engine above without the process-driven main loop
+#ifndef HARNESS
 int main(int argc, char **argv) {
     // Declare variables
     int map_width, map_height, obs_count, i;
     int hunter_count, prey_count;
     int alive_hunter_count, alive_prey_count;
+    int opt, tile_count = 1, use_uring = 0, hibernate_dist = 0, use_cache = 0;
+    int pack_every = 0, alive_prey_before;
+    char *kernels = NULL;
+    int server_cpu = -1, numa_spread = 0, colocate = 0;
+    char *agent_cpus = NULL;
+    int component_count, reachable;
+    int *components;
+    char *telemetry_path = NULL;
+
+    // Parse options
+    while ((opt = getopt(argc, argv, "t:r:T:uS:A:NCH:cP:K:")) != -1) {
+        switch (opt) {
+            case 't':
+                tile_count = atoi(optarg);
+                break;
+            case 'r':
+                if (render_add_spectator(optarg) < 0) {
+                    fprintf(stderr, "Bad spectator: %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'T':
+                telemetry_path = optarg;
+                break;
+            case 'u':
+                use_uring = 1;
+                break;
+            case 'S':
+                server_cpu = atoi(optarg);
+                break;
+            case 'A':
+                agent_cpus = optarg;
+                break;
+            case 'N':
+                numa_spread = 1;
+                break;
+            case 'C':
+                colocate = 1;
+                break;
+            case 'H':
+                hibernate_dist = atoi(optarg);
+                break;
+            case 'c':
+                use_cache = 1;
+                break;
+            case 'P':
+                pack_every = atoi(optarg);
+                break;
+            case 'K':
+                kernels = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-t tiles] [-r term[:fps] | -r file:path[:fps]]... [-T telemetry] [-u]\n"
+                                "       [-S server_cpu] [-A agent_cpus | -N] [-C] [-H dist] [-c] [-P n]\n"
+                                "       [-K generic|typed|fixed] < input\n", argv[0]);
+                exit(1);
+        }
+    }
+
+    if (placement_init(server_cpu, agent_cpus, numa_spread, colocate) < 0) {
+        fprintf(stderr, "Bad placement, -C needs -S and every CPU in -S and -A must be online\n");
+        exit(1);
+    }
     
     // Input map, hunter, prey and obs details
     scanf("%d %d", &map_width, &map_height);
@@ -502,41 +607,120 @@ int main(int argc, char **argv) {
     int h_pipes[hunter_count][2];
     int p_pipes[prey_count][2];
 
+    // Pick the hot-path kernels for this map, the fastest that fits by default
+    if (kernels_init(map_width, kernels) < 0) {
+        fprintf(stderr, "No %s kernels for width %d\n", kernels, map_width);
+        exit(1);
+    }
+
     // Initialize map with hunters' and preys' locations
     initialize_map(map, map_width, hunters, hunter_count, preys, prey_count);
 
+    // Label free space to detect games no side can win
+    components = label_components(map, map_width, map_height, &component_count);
+    reachable = preys_reachable(components, component_count, map, map_width, map_height);
+
     // Print initial map
-    print_map(map, map_width, map_height);
+    render_init(map_width, map_height);
+    render_frame(map, map_width, map_height);
 
     // Setup children processes and communication
     setup_children(hunters, hunter_count, h_pipes, preys, prey_count,
                     p_pipes, map, map_width, map_height);
 
+    // Hand the game over to the tile servers in distributed mode
+    if (tile_count > 1) {
+        if (hibernate_dist > 0) {
+            fprintf(stderr, "Hibernation needs a single server, ignoring -H\n");
+        }
+        if (use_cache) {
+            fprintf(stderr, "The nearest-adversary cache needs a single server, ignoring -c\n");
+        }
+        if (pack_every > 0) {
+            fprintf(stderr, "Pack coordination needs a single server, ignoring -P\n");
+        }
+        if (use_uring) {
+            fprintf(stderr, "io_uring needs a single server, ignoring -u\n");
+        }
+        reachable = run_distributed(map, map_width, map_height, hunters, hunter_count,
+                                    preys, prey_count, h_pipes, p_pipes, tile_count, telemetry_path,
+                                    components, component_count);
+        render_stop();
+        if (!reachable) {
+            fprintf(stderr, "Stalemate: no hunter can reach any prey\n");
+            exit(EXIT_STALEMATE);
+        }
+        exit(0);
+    }
+
+    // Spectators and telemetry start after every fork so no child inherits their threads
+    render_start();
+    if (telemetry_path != NULL) {
+        telemetry_open(telemetry_path, hunter_count, prey_count);
+    }
+
+    // Pin the loop itself last so the helper threads keep floating
+    placement_apply_server();
+    placement_report(stderr, hunters, hunter_count, preys, prey_count);
+
     //printf("Server: All processes created successfully\n");
 
     // Declare pollfd
     uint8_t map_updated = 0;
     struct pollfd pfd_h[hunter_count];
     struct pollfd pfd_p[prey_count];
-    server_message state;
+    server_message state, reply;
     ph_message request;
     actor_t actor_type;
+    uint8_t accepted;
+    uint64_t t_read;
+    int frames;
+    int alive_actor_count;
+    int agent_fds[hunter_count + prey_count];
+    uint8_t ready[hunter_count + prey_count];
+    uint8_t wake[hunter_count + prey_count];
+    frame_reader *h_readers = malloc((hunter_count + 1) * sizeof(frame_reader));
+    frame_reader *p_readers = malloc((prey_count + 1) * sizeof(frame_reader));
 
     // Setup pfds
     for (i = 0; i < hunter_count; ++i) {
         pfd_h[i].fd = h_pipes[i][0];
         pfd_h[i].events = POLLIN;
         pfd_h[i].revents = 0;
+        frame_reader_init(&h_readers[i], sizeof(ph_message));
     }
 
     for (i = 0; i < prey_count; ++i) {
         pfd_p[i].fd = p_pipes[i][0];
         pfd_p[i].events = POLLIN;
         pfd_p[i].revents = 0;
+        frame_reader_init(&p_readers[i], sizeof(ph_message));
+    }
+
+    // Hand the agent sockets to io_uring, fall back to poll if the kernel refuses
+    if (use_uring) {
+        for (i = 0; i < hunter_count; ++i) {
+            agent_fds[i] = h_pipes[i][0];
+        }
+        for (i = 0; i < prey_count; ++i) {
+            agent_fds[hunter_count + i] = p_pipes[i][0];
+        }
+        if (uring_open(agent_fds, hunter_count + prey_count) < 0) {
+            fprintf(stderr, "io_uring unavailable, using poll\n");
+            use_uring = 0;
+        }
+    }
+
+    hibernate_init(hibernate_dist, hunter_count, prey_count, map_width, map_height);
+    if (use_cache) {
+        nearest_init(hunters, hunter_count, preys, prey_count, map_width, map_height);
+    }
+    if (pack_every > 0) {
+        pack_init(pack_every, hunters, hunter_count, preys, prey_count, map_width, map_height);
     }
 
     // Main loop
-    while (alive_prey_count > 0 && alive_hunter_count > 0) {
+    while (alive_prey_count > 0 && alive_hunter_count > 0 && reachable) {
         // Reset revents
         for (i = 0; i < hunter_count; ++i) {
             if (pfd_h[i].fd >= 0) {
@@ -550,56 +734,141 @@ int main(int argc, char **argv) {
             }
         }
 
-        // Poll for hunters - 1
-        poll(pfd_h, hunter_count, 0);
+        // Poll for hunters - 1, io_uring reaps every agent at once
+        if (use_uring) {
+            uring_wait(ready);
+        } else {
+            poll(pfd_h, hunter_count, 0);
+        }
         // For hunters that ready process their request - 2
         for (i = 0; i < hunter_count; ++i) {
-            if (pfd_h[i].revents && POLLIN) {
+            if (use_uring ? (ready[i] && pfd_h[i].fd >= 0) : (pfd_h[i].revents && POLLIN)) {
                 // pid_t pid;
-                // Read request - 2a
-                read(pfd_h[i].fd, &request, sizeof(ph_message));
+                // Read request - 2a, only the latest queued one matters
+                t_read = telemetry_now();
+                if (use_uring) {
+                    request = *uring_request(i);
+                } else if ((frames = frame_read_latest(pfd_h[i].fd, &h_readers[i], &request, 0)) <= 0) {
+                    // The agent is gone, stop polling its socket; end_agent must not close it again
+                    if (frames < 0) {
+                        close(pfd_h[i].fd);
+                        pfd_h[i].fd = -1;
+                        h_pipes[i][0] = -1;
+                    }
+                    continue;
+                }
                 // Print request
                 /* printf("Request from HUNTER(%d)(%d), from %d,%d to %d,%d\n", hunters[i].pid,hunters[i].energy, 
                         hunters[i].pos.x, hunters[i].pos.y, request.move_request.x, request.move_request.y); */
                 // Handle request - 2b 2c
-                map_updated |= handle_request(request, map, hunters, preys, HUNTER, i, map_width);
+                accepted = kernel_request(request, map, hunters, preys, HUNTER, i, map_width);
+                map_updated |= accepted;
+                if (accepted) {
+                    hibernate_moved(HUNTER, hunters[i].pos);
+                }
                 // Create new state for current actor - 2d
-                state = get_state(map, HUNTER, hunters[i].pos.x, hunters[i].pos.y, map_width, map_height);
+                state = nearest_state(map, HUNTER, i, hunters[i].pos.x, hunters[i].pos.y, map_width, map_height);
                 // pid = hunters[i].pid;
                 // Send new state
                 // printf("Send request coming from fd:(%d) to process(%d)\n", pfd_h[i].fd, pid);
-                write(pfd_h[i].fd, &state, sizeof(server_message));
+                // No adversary in range: hold the reply, the agent sleeps until one comes close
+                if (!hibernate_hold(HUNTER, i, &state)) {
+                    // Telemetry keeps the nearest adversary, the agent gets its assigned prey
+                    reply = pack_target(i, state);
+                    if (use_uring) {
+                        uring_reply(i, &reply);
+                    } else {
+                        write_frame(pfd_h[i].fd, &reply, sizeof(server_message));
+                    }
+                }
+                telemetry_move(HUNTER, i, hunters[i].pos, hunters[i].energy, accepted, t_read, &state);
             }
         }
         
         
 
         // Poll for preys - 1
-        poll(pfd_p, prey_count, 0);
+        if (!use_uring) {
+            poll(pfd_p, prey_count, 0);
+        }
         // For hunters that ready process their request - 2
         for (i = 0; i < prey_count; ++i) {
-            if (pfd_p[i].revents && POLLIN) {
+            if (use_uring ? (ready[hunter_count + i] && pfd_p[i].fd >= 0) : (pfd_p[i].revents && POLLIN)) {
                 // pid_t pid;
-                // Read request - 2a
-                read(pfd_p[i].fd, &request, sizeof(ph_message));
+                // Read request - 2a, only the latest queued one matters
+                t_read = telemetry_now();
+                if (use_uring) {
+                    request = *uring_request(hunter_count + i);
+                } else if ((frames = frame_read_latest(pfd_p[i].fd, &p_readers[i], &request, 0)) <= 0) {
+                    // The agent is gone, stop polling its socket; end_agent must not close it again
+                    if (frames < 0) {
+                        close(pfd_p[i].fd);
+                        pfd_p[i].fd = -1;
+                        p_pipes[i][0] = -1;
+                    }
+                    continue;
+                }
                 // Print request
                 /* printf("Request from PREY(%d), from %d,%d to %d,%d\n", preys[i].pid, preys[i].pos.x, 
                         preys[i].pos.y, request.move_request.x, request.move_request.y); */
                 // Handle request - 2b 2c
-                map_updated |= handle_request(request, map, hunters, preys, PREY, i, map_width);
+                accepted = kernel_request(request, map, hunters, preys, PREY, i, map_width);
+                map_updated |= accepted;
+                if (accepted) {
+                    hibernate_moved(PREY, preys[i].pos);
+                }
                 // Create new state for current actor - 2d
-                state = get_state(map, PREY, preys[i].pos.x, preys[i].pos.y, map_width, map_height);
+                state = nearest_state(map, PREY, i, preys[i].pos.x, preys[i].pos.y, map_width, map_height);
                 // pid = preys[i].pid;
                 // Send new state
                 // printf("Send request coming from fd:(%d) to process(%d)\n", pfd_p[i].fd, pid);
-                write(pfd_p[i].fd, &state, sizeof(server_message));
+                // No adversary in range: hold the reply, the agent sleeps until one comes close
+                if (!hibernate_hold(PREY, i, &state)) {
+                    if (use_uring) {
+                        uring_reply(hunter_count + i, &state);
+                    } else {
+                        write_frame(pfd_p[i].fd, &state, sizeof(server_message));
+                    }
+                }
+                telemetry_move(PREY, i, preys[i].pos, preys[i].stored_energy, accepted, t_read, &state);
             }
         }
 
         if (map_updated) {
+            alive_actor_count = alive_hunter_count + alive_prey_count;
+            alive_prey_before = alive_prey_count;
             update_map(map, map_width, hunters, hunter_count, preys, prey_count, 
                         &alive_prey_count, &alive_hunter_count, h_pipes, p_pipes, pfd_h, pfd_p);
-            print_map(map, map_width, map_height);
+            // Hunters of a dead prey are reassigned right away
+            pack_update(hunters, preys, alive_prey_count != alive_prey_before);
+            render_frame(map, map_width, map_height);
+            // Moves stay inside a component, only deaths can separate the sides
+            if (alive_hunter_count > 0 && alive_prey_count > 0
+                && alive_hunter_count + alive_prey_count != alive_actor_count) {
+                reachable = preys_reachable(components, component_count, map, map_width, map_height);
+            }
+        }
+
+        // Sleepers an adversary came close to get their held state now
+        if (hibernate_dist > 0 && hibernate_wake(hunters, preys, wake) > 0) {
+            for (i = 0; i < hunter_count + prey_count; ++i) {
+                if (!wake[i]) {
+                    continue;
+                }
+                if (i < hunter_count) {
+                    state = pack_target(i, nearest_state(map, HUNTER, i, hunters[i].pos.x, hunters[i].pos.y,
+                                                         map_width, map_height));
+                } else {
+                    state = nearest_state(map, PREY, i - hunter_count, preys[i - hunter_count].pos.x,
+                                          preys[i - hunter_count].pos.y, map_width, map_height);
+                }
+                if (use_uring) {
+                    uring_reply(i, &state);
+                } else {
+                    write_frame(i < hunter_count ? pfd_h[i].fd : pfd_p[i - hunter_count].fd,
+                                &state, sizeof(server_message));
+                }
+            }
         }
 
         map_updated = 0;
@@ -608,5 +877,22 @@ int main(int argc, char **argv) {
     kill_remaining(hunters, preys, hunter_count, prey_count, 
                     alive_hunter_count, alive_prey_count, h_pipes, p_pipes);
 
+    uring_close();
+    hibernate_close();
+    nearest_close();
+    pack_close();
+    telemetry_close();
+    render_stop();
+
+    free(h_readers);
+    free(p_readers);
+    free(components);
+
+    if (!reachable) {
+        fprintf(stderr, "Stalemate: no hunter can reach any prey\n");
+        exit(EXIT_STALEMATE);
+    }
+
     exit(0);
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,115 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "structs.h"
+
+#define PIPE(fd) socketpair(AF_UNIX, SOCK_STREAM, 0, fd)
+
+// Exit status when no hunter can reach any prey
+#define EXIT_STALEMATE 2
+
+int get1D(int x, int y, int width);
+uint16_t encode_actor(actor_t a, int index);
+actor_t decode_actor(uint16_t encd);
+uint16_t decode_index(uint16_t encd);
+int manhattan_dist(coordinate pos1, coordinate pos2);
+
+void fprint_map(FILE *out, uint16_t *map, int map_width, int map_height);
+void print_map(uint16_t *map, int map_width, int map_height);
+void end_agent(pid_t pid, int fd);
+void update_map(uint16_t *map, int map_width, Hunter *hunters, int hunter_count,
+                Prey *preys, int prey_count, int *alive_prey_count, int *alive_hunter_count,
+                int h_pipes[][2], int p_pipes[][2], struct pollfd *pfd_h, struct pollfd *pfd_p);
+server_message get_state(uint16_t *map, actor_t a, int x, int y, int map_width, int map_height);
+int scan_adversary(uint16_t *map, actor_t a, int x, int y, int map_width, int map_height,
+                   int start_ring, coordinate *adv_pos);
+void scan_neighbours(uint16_t *map, actor_t a, server_message *state, int map_width, int map_height);
+uint8_t handle_request(ph_message request, uint16_t *map, Hunter *hunters,
+                        Prey *preys, actor_t a, int index, int map_width);
+void move_actor(uint16_t *map, int x, int y, int new_x, int new_y, actor_t a, int map_width);
+void kill_remaining(Hunter *hunters, Prey *preys, int hunter_count, int prey_count,
+                    int alive_hunter_count, int alive_prey_count, int h_pipes[][2], int p_pipes[][2]);
+
+// Reachability (reach.c)
+int *label_components(uint16_t *map, int map_width, int map_height, int *component_count);
+int preys_reachable(int *labels, int component_count, uint16_t *map, int map_width, int map_height);
+
+// io_uring backend (uring.c)
+int uring_open(int *fds, int count);
+int uring_wait(uint8_t *ready);
+ph_message *uring_request(int slot);
+void uring_reply(int slot, server_message *state);
+void uring_close(void);
+
+// Hot-path kernels (kernels.c)
+int kernels_init(int map_width, const char *name);
+const char *kernels_name(void);
+int kernel_scan(uint16_t *map, actor_t a, int x, int y, int map_width, int map_height,
+                int start_ring, coordinate *adv_pos);
+void kernel_neighbours(uint16_t *map, actor_t a, server_message *state, int map_width, int map_height);
+server_message kernel_state(uint16_t *map, actor_t a, int x, int y, int map_width, int map_height);
+uint8_t kernel_request(ph_message request, uint16_t *map, Hunter *hunters, Prey *preys,
+                       actor_t a, int index, int map_width);
+
+// Nearest-adversary cache (nearest.c)
+void nearest_init(Hunter *hunters, int hunter_count, Prey *preys, int prey_count,
+                  int map_width, int map_height);
+void nearest_cell(int x, int y, uint16_t old_encd, uint16_t new_encd);
+void nearest_moved(actor_t a, int index, coordinate pos);
+server_message nearest_state(uint16_t *map, actor_t a, int index, int x, int y,
+                             int map_width, int map_height);
+void nearest_close(void);
+
+// Pack coordination (pack.c)
+void pack_init(int n, Hunter *hunters, int hunter_count, Prey *preys, int prey_count,
+               int map_width, int map_height);
+void pack_assign(Hunter *hunters, Prey *preys);
+void pack_update(Hunter *hunters, Prey *preys, int prey_died);
+server_message pack_target(int index, server_message state);
+void pack_close(void);
+
+// Hibernation (hibernate.c)
+void hibernate_init(int dist, int hunter_count, int prey_count, int map_width, int map_height);
+int hibernate_hold(actor_t a, int index, server_message *state);
+void hibernate_moved(actor_t a, coordinate pos);
+int hibernate_wake(Hunter *hunters, Prey *preys, uint8_t *wake);
+void hibernate_close(void);
+
+// CPU placement (placement.c)
+int placement_init(int cpu, const char *agent_list, int numa_spread, int colocate);
+void placement_apply_agent(pid_t pid, int ordinal);
+void placement_apply_server(void);
+void placement_apply_tile(int id);
+void placement_report_tile(FILE *out, int id, pid_t pid);
+void placement_report(FILE *out, Hunter *hunters, int hunter_count, Prey *preys, int prey_count);
+
+// Distributed mode (tile.c)
+int run_distributed(uint16_t *map, int map_width, int map_height, Hunter *hunters, int hunter_count,
+                     Prey *preys, int prey_count, int h_pipes[][2], int p_pipes[][2], int tile_count,
+                     const char *telemetry_path, int *components, int component_count);
+void tile_strip(int y, int tile_count, int map_height, int *origin, int *rows);
+int tile_strip_state(uint16_t *strip, actor_t a, coordinate pos, int origin, int rows,
+                     int map_width, int map_height, server_message *state);
+
+// Renderer (render.c)
+int render_add_spectator(const char *spec);
+void render_init(int map_width, int map_height);
+void render_frame(uint16_t *map, int map_width, int map_height);
+void render_start(void);
+void render_stop(void);
+
+// Telemetry (telemetry.c)
+void telemetry_open(const char *path, int hunter_count, int prey_count);
+uint64_t telemetry_now(void);
+void telemetry_offset(int rows);
+void telemetry_move(actor_t a, int index, coordinate pos, int energy, uint8_t accepted,
+                    uint64_t t_read, server_message *state);
+void telemetry_death(actor_t a, int index, coordinate pos, int energy);
+void telemetry_close(void);
+
+#endif
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include "structs.h"
+#include "server.h"
+
+/*
+ * Per-actor telemetry. Every served request and every death becomes one row.
+ * Rows are appended to a batch owned by the recording thread; full batches
+ * are handed to a writer thread, so recording costs two clock reads and a few
+ * stores.
+ *
+ * File layout (host byte order, the reader must run on a machine of the same
+ * endianness; every column naturally aligned):
+ *
+ *   telemetry_header
+ *   telemetry_column[TELEMETRY_COLUMNS]
+ *   chunk*: telemetry_chunk, then each column's rows back to back
+ *           (rows * width bytes each), the chunk padded to 8 bytes
+ *
+ * Columns are ordered by decreasing width and every chunk starts 8-byte
+ * aligned, so each column starts on a multiple of its own width.
+ * A reader mmaps the file and walks the chunks; inside a chunk every column
+ * is a plain fixed-width array.
+ */
+
+#define TELEMETRY_MAGIC 0x4c545048 /* "HPTL" */
+#define CHUNK_MAGIC 0x4b4e4843     /* "CHNK" */
+#define BATCH_ROWS 4096
+#define TELEMETRY_COLUMNS 12
+
+enum { EVENT_MOVE = 0, EVENT_DEATH = 1 };
+
+typedef struct telemetry_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t columns;
+    uint32_t chunk_rows;
+} telemetry_header;
+
+typedef struct telemetry_column {
+    char name[12];
+    uint32_t width;
+} telemetry_column;
+
+typedef struct telemetry_chunk {
+    uint32_t magic;
+    uint32_t rows;
+} telemetry_chunk;
+
+static const telemetry_column columns[TELEMETRY_COLUMNS] = {
+    {"t_ns", 8},        // time since telemetry_open
+    {"wait_ns", 8},     // since the previous reply to this actor, 0 on its first request
+    {"index", 4},
+    {"x", 4},
+    {"y", 4},
+    {"energy", 4},      // hunter energy or prey stored energy
+    {"accepted", 4},    // cumulative accepted moves of the actor
+    {"rejected", 4},    // cumulative rejected moves of the actor
+    {"service_ns", 4},  // request read to reply written
+    {"adv_dist", 4},    // from get_state, -1 without adversary
+    {"type", 1},        // actor_t
+    {"event", 1},       // EVENT_MOVE or EVENT_DEATH
+};
+
+typedef struct batch {
+    uint32_t rows;
+    uint64_t t_ns[BATCH_ROWS];
+    uint64_t wait_ns[BATCH_ROWS];
+    int32_t index[BATCH_ROWS];
+    int32_t x[BATCH_ROWS];
+    int32_t y[BATCH_ROWS];
+    int32_t energy[BATCH_ROWS];
+    uint32_t accepted[BATCH_ROWS];
+    uint32_t rejected[BATCH_ROWS];
+    uint32_t service_ns[BATCH_ROWS];
+    int32_t adv_dist[BATCH_ROWS];
+    uint8_t type[BATCH_ROWS];
+    uint8_t event[BATCH_ROWS];
+    struct batch *next;
+} batch;
+
+typedef struct actor_stats {
+    uint64_t last_reply;
+    uint32_t accepted;
+    uint32_t rejected;
+} actor_stats;
+
+static int enabled = 0;
+static int row_offset = 0;
+static FILE *out;
+static uint64_t start_ns;
+static actor_stats *h_stats, *p_stats;
+
+static _Thread_local batch *local_batch;
+
+// Full batches waiting for the writer, and drained ones ready for reuse
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pending_cond = PTHREAD_COND_INITIALIZER;
+static batch *pending_head, *pending_tail, *free_list;
+static int closing = 0;
+static pthread_t writer;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void write_chunk(batch *b) {
+    static const char zeros[8] = {0};
+    telemetry_chunk chunk = { CHUNK_MAGIC, b->rows };
+    size_t bytes = 0;
+
+    fwrite(&chunk, sizeof chunk, 1, out);
+    bytes += fwrite(b->t_ns, 8, b->rows, out) * 8;
+    bytes += fwrite(b->wait_ns, 8, b->rows, out) * 8;
+    bytes += fwrite(b->index, 4, b->rows, out) * 4;
+    bytes += fwrite(b->x, 4, b->rows, out) * 4;
+    bytes += fwrite(b->y, 4, b->rows, out) * 4;
+    bytes += fwrite(b->energy, 4, b->rows, out) * 4;
+    bytes += fwrite(b->accepted, 4, b->rows, out) * 4;
+    bytes += fwrite(b->rejected, 4, b->rows, out) * 4;
+    bytes += fwrite(b->service_ns, 4, b->rows, out) * 4;
+    bytes += fwrite(b->adv_dist, 4, b->rows, out) * 4;
+    bytes += fwrite(b->type, 1, b->rows, out);
+    bytes += fwrite(b->event, 1, b->rows, out);
+    fwrite(zeros, 1, (8 - bytes % 8) % 8, out);
+}
+
+static void *writer_loop(void *arg) {
+    batch *b;
+
+    pthread_mutex_lock(&lock);
+    while (1) {
+        while (pending_head == NULL && !closing) {
+            pthread_cond_wait(&pending_cond, &lock);
+        }
+        if (pending_head == NULL) {
+            break;
+        }
+        b = pending_head;
+        pending_head = b->next;
+        if (pending_head == NULL) {
+            pending_tail = NULL;
+        }
+        pthread_mutex_unlock(&lock);
+
+        write_chunk(b);
+
+        pthread_mutex_lock(&lock);
+        b->next = free_list;
+        free_list = b;
+    }
+    pthread_mutex_unlock(&lock);
+
+    fflush(out);
+    return NULL;
+}
+
+static void submit_batch(batch *b) {
+    pthread_mutex_lock(&lock);
+    b->next = NULL;
+    if (pending_tail != NULL) {
+        pending_tail->next = b;
+    } else {
+        pending_head = b;
+    }
+    pending_tail = b;
+    pthread_cond_signal(&pending_cond);
+    pthread_mutex_unlock(&lock);
+}
+
+static batch *get_batch(void) {
+    batch *b;
+
+    if (local_batch != NULL && local_batch->rows < BATCH_ROWS) {
+        return local_batch;
+    }
+    if (local_batch != NULL) {
+        submit_batch(local_batch);
+    }
+
+    pthread_mutex_lock(&lock);
+    if ((b = free_list) != NULL) {
+        free_list = b->next;
+    }
+    pthread_mutex_unlock(&lock);
+
+    // Writer fell behind, grow the pool instead of stalling the server
+    if (b == NULL && (b = malloc(sizeof(batch))) == NULL) {
+        perror("Telemetry batch error");
+        exit(1);
+    }
+    b->rows = 0;
+    local_batch = b;
+    return b;
+}
+
+void telemetry_open(const char *path, int hunter_count, int prey_count) {
+    telemetry_header header = { TELEMETRY_MAGIC, 1, TELEMETRY_COLUMNS, BATCH_ROWS };
+
+    if ((out = fopen(path, "w")) == NULL) {
+        perror("Telemetry file error");
+        exit(1);
+    }
+    fwrite(&header, sizeof header, 1, out);
+    fwrite(columns, sizeof(telemetry_column), TELEMETRY_COLUMNS, out);
+
+    h_stats = calloc(hunter_count + 1, sizeof(actor_stats));
+    p_stats = calloc(prey_count + 1, sizeof(actor_stats));
+
+    if (pthread_create(&writer, NULL, writer_loop, NULL) != 0) {
+        perror("Telemetry thread error");
+        exit(1);
+    }
+
+    start_ns = now_ns();
+    enabled = 1;
+}
+
+// Added to every recorded row, a tile records its strip in map coordinates
+void telemetry_offset(int rows) {
+    row_offset = rows;
+}
+
+uint64_t telemetry_now(void) {
+    return enabled ? now_ns() : 0;
+}
+
+static void append(actor_t a, int index, coordinate pos, int energy, int event,
+                   uint64_t t, uint64_t wait, uint64_t service, int adv_dist) {
+    batch *b = get_batch();
+    actor_stats *st = (a == HUNTER) ? &h_stats[index] : &p_stats[index];
+    uint32_t r = b->rows++;
+
+    b->t_ns[r] = t - start_ns;
+    b->wait_ns[r] = wait;
+    b->index[r] = index;
+    b->x[r] = pos.x;
+    b->y[r] = pos.y + row_offset;
+    b->energy[r] = energy;
+    b->accepted[r] = st->accepted;
+    b->rejected[r] = st->rejected;
+    b->service_ns[r] = service > UINT32_MAX ? UINT32_MAX : service;
+    b->adv_dist[r] = adv_dist;
+    b->type[r] = a;
+    b->event[r] = event;
+}
+
+void telemetry_move(actor_t a, int index, coordinate pos, int energy, uint8_t accepted,
+                    uint64_t t_read, server_message *state) {
+    actor_stats *st;
+    uint64_t t, wait;
+    int adv_dist;
+
+    if (!enabled) {
+        return;
+    }
+
+    t = now_ns();
+    st = (a == HUNTER) ? &h_stats[index] : &p_stats[index];
+    if (accepted) {
+        st->accepted++;
+    } else {
+        st->rejected++;
+    }
+    wait = st->last_reply ? t_read - st->last_reply : 0;
+    st->last_reply = t;
+
+    if (state->adv_pos.x == state->pos.x && state->adv_pos.y == state->pos.y) {
+        adv_dist = -1;
+    } else {
+        adv_dist = manhattan_dist(state->pos, state->adv_pos);
+    }
+
+    append(a, index, pos, energy, EVENT_MOVE, t, wait, t - t_read, adv_dist);
+}
+
+void telemetry_death(actor_t a, int index, coordinate pos, int energy) {
+    if (!enabled) {
+        return;
+    }
+    append(a, index, pos, energy, EVENT_DEATH, now_ns(), 0, 0, -1);
+}
+
+void telemetry_close(void) {
+    if (!enabled) {
+        return;
+    }
+    enabled = 0;
+
+    if (local_batch != NULL && local_batch->rows > 0) {
+        submit_batch(local_batch);
+        local_batch = NULL;
+    }
+
+    pthread_mutex_lock(&lock);
+    closing = 1;
+    pthread_cond_signal(&pending_cond);
+    pthread_mutex_unlock(&lock);
+
+    pthread_join(writer, NULL);
+    fclose(out);
+
+    while (free_list != NULL) {
+        local_batch = free_list;
+        free_list = free_list->next;
+        free(local_batch);
+    }
+    local_batch = NULL;
+    free(h_stats);
+    free(p_stats);
+}
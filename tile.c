@@ -0,0 +1,847 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <stdint.h>
+#include "structs.h"
+#include "server.h"
+#include "framing.h"
+
+/*
+ * Distributed mode: the map is cut into horizontal strips and every strip
+ * (tile) is run by its own server process. A tile owns the actors standing
+ * on its rows and mirrors one halo row from each neighbouring tile. Ticks run
+ * in lockstep:
+ *
+ *   1. serve own agents; moves into a halo row become migrations
+ *   2. swap boundary rows and migrations with both neighbours
+ *   3. resolve incoming migrations and send back acks
+ *   4. update_map, then report to the coordinator
+ *
+ * The coordinator (the original server process) merges the reported rows for
+ * render_frame, decides when the game is over and broadcasts a coarse summary:
+ * per block, the actor count and the position of one actor in it.
+ *
+ * A tile only holds its own rows and the two halo rows, and works in strip
+ * coordinates (row 0 is the first row it holds), so the ring scan never looks
+ * past the halo. Agents keep talking in map coordinates. An adversary found on
+ * the strip is exact only when it is nearer than the first row past the halo;
+ * otherwise it is weighed against the summary's actor of the nearest populated
+ * block of another tile. An agent pointed at such a block keeps it as its
+ * target, across migrations too, until it empties or something nearer turns
+ * up on the strip.
+ *
+ * Tiles reach each other and the coordinator over TCP, here on the loopback
+ * interface. The agents are still children of the server and their socket
+ * pairs are inherited, so every tile runs on the machine the agents run on.
+ */
+
+// Width of a column block in the coarse summary
+#define SUMMARY_BLOCK 8
+
+// Coordinates on the wire are map coordinates
+typedef struct migration {
+    int type;
+    int index;
+    coordinate from;
+    coordinate to;
+    int energy;
+    int target;
+} migration;
+
+typedef struct migration_ack {
+    int accepted;
+} migration_ack;
+
+typedef struct tile_report {
+    int hunters;
+    int preys;
+    int updated;
+} tile_report;
+
+typedef struct block_summary {
+    int count;
+    coordinate pos;         // one actor of the block, in map coordinates
+} block_summary;
+
+typedef struct tile_control {
+    int running;
+    int alive_hunters;
+    int alive_preys;
+    int summary_changed;
+} tile_control;
+
+typedef struct tile {
+    int id, count;
+    int y0, y1;                     // owned map rows
+    int origin;                     // map row of strip row 0
+    int up_fd, down_fd, ctl_fd;
+    uint16_t *map;                  // strip and halo rows only
+    int map_width, map_height;      // map_height counts the rows held
+    int full_height;                // rows of the whole map
+    Hunter *hunters;
+    int hunter_count;
+    Prey *preys;
+    int prey_count;
+    int (*h_pipes)[2];
+    int (*p_pipes)[2];
+    struct pollfd *pfd_h, *pfd_p;
+    frame_reader *h_readers, *p_readers;
+    int *h_targets, *p_targets;     // summary block chased, -1 for none
+    int blocks_x;
+    block_summary *summary;
+    migration *out_up, *out_down;
+    int out_up_count, out_down_count;
+    const char *telemetry_path;
+} tile;
+
+static void write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = write(fd, p, len)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Tile write error");
+            exit(1);
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+static void read_all(int fd, void *buf, size_t len) {
+    char *p = buf;
+    ssize_t n;
+
+    while (len > 0) {
+        if ((n = read(fd, p, len)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Tile read error");
+            exit(1);
+        } else if (n == 0) {
+            fprintf(stderr, "Tile read error: peer closed\n");
+            exit(1);
+        }
+        p += n;
+        len -= n;
+    }
+}
+
+// Listens on an ephemeral loopback port, returned in network byte order
+static int tcp_listen(uint16_t *port) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = 0 };
+    socklen_t len = sizeof addr;
+    int fd;
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0
+        || bind(fd, (struct sockaddr *)&addr, sizeof addr) < 0
+        || listen(fd, SOMAXCONN) < 0
+        || getsockname(fd, (struct sockaddr *)&addr, &len) < 0) {
+        perror("Tile listen error");
+        exit(1);
+    }
+    *port = addr.sin_port;
+    return fd;
+}
+
+// Ticks trade small messages in lockstep, Nagle would hold every one of them
+static void no_delay(int fd) {
+    int one = 1;
+
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one) < 0) {
+        perror("Tile socket option error");
+        exit(1);
+    }
+}
+
+static int tcp_connect(uint16_t port) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = port };
+    int fd;
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        perror("Tile socket error");
+        exit(1);
+    }
+    while (connect(fd, (struct sockaddr *)&addr, sizeof addr) < 0) {
+        if (errno != EINTR) {
+            perror("Tile connect error");
+            exit(1);
+        }
+    }
+    no_delay(fd);
+    return fd;
+}
+
+static int tcp_accept(int listen_fd) {
+    int fd;
+
+    while ((fd = accept(listen_fd, NULL, NULL)) < 0) {
+        if (errno != EINTR) {
+            perror("Tile accept error");
+            exit(1);
+        }
+    }
+    no_delay(fd);
+    return fd;
+}
+
+static void tile_rows(int id, int count, int map_height, int *y0, int *y1) {
+    *y0 = id * map_height / count;
+    *y1 = (id + 1) * map_height / count;
+}
+
+static int tile_of_row(int y, int count, int map_height) {
+    int id, y0, y1;
+
+    for (id = 0; id < count; ++id) {
+        tile_rows(id, count, map_height, &y0, &y1);
+        if (y >= y0 && y < y1) {
+            return id;
+        }
+    }
+    return count - 1;
+}
+
+// The rows tile_count tiles leave to the tile owning map row y, halo included
+void tile_strip(int y, int tile_count, int map_height, int *origin, int *rows) {
+    int y0, y1;
+
+    if (tile_count > map_height) {
+        tile_count = map_height;
+    }
+    tile_rows(tile_of_row(y, tile_count, map_height), tile_count, map_height, &y0, &y1);
+    *origin = (y0 > 0) ? y0 - 1 : 0;
+    *rows = ((y1 < map_height) ? y1 + 1 : map_height) - *origin;
+}
+
+static coordinate to_map(tile *t, coordinate c) {
+    c.y += t->origin;
+    return c;
+}
+
+static coordinate to_strip(tile *t, coordinate c) {
+    c.y -= t->origin;
+    return c;
+}
+
+static void add_to_block(block_summary *s, coordinate pos) {
+    // The first actor found stands for the block
+    if (s->count++ == 0) {
+        s->pos = pos;
+    }
+}
+
+/*
+ * Summary layout is [tile][block][0 = hunters, 1 = preys]. Actor rows are
+ * shifted by origin to map rows; with count 1 everything lands in tile 0.
+ */
+static void count_blocks(Hunter *hunters, int hunter_count, Prey *preys, int prey_count,
+                         block_summary *summary, int blocks_x, int count, int map_height, int origin) {
+    int i, id;
+    coordinate pos;
+
+    for (i = 0; i < hunter_count; ++i) {
+        if (hunters[i].alive) {
+            pos = hunters[i].pos;
+            pos.y += origin;
+            id = tile_of_row(pos.y, count, map_height);
+            add_to_block(&summary[(id * blocks_x + pos.x / SUMMARY_BLOCK) * 2], pos);
+        }
+    }
+
+    for (i = 0; i < prey_count; ++i) {
+        if (preys[i].alive) {
+            pos = preys[i].pos;
+            pos.y += origin;
+            id = tile_of_row(pos.y, count, map_height);
+            add_to_block(&summary[(id * blocks_x + pos.x / SUMMARY_BLOCK) * 2 + 1], pos);
+        }
+    }
+}
+
+/*
+ * kernel_state for the actor at pos on a strip holding the map rows
+ * [origin, origin + rows), pos and the reply in map coordinates. Returns 1
+ * when the reply is exact: the adversary found is nearer than any cell past
+ * the strip. Otherwise a nearer one may stand outside, or none was found.
+ */
+int tile_strip_state(uint16_t *strip, actor_t a, coordinate pos, int origin, int rows,
+                     int map_width, int map_height, server_message *state) {
+    int k, limit = INT_MAX;
+
+    *state = kernel_state(strip, a, pos.x, pos.y - origin, map_width, rows);
+    state->pos.y += origin;
+    state->adv_pos.y += origin;
+    for (k = 0; k < state->object_count; ++k) {
+        state->object_pos[k].y += origin;
+    }
+
+    // Distance to the nearest row past the strip; a tie could still sit earlier in ring order
+    if (origin > 0) {
+        limit = pos.y - origin + 1;
+    }
+    if (origin + rows < map_height && origin + rows - pos.y < limit) {
+        limit = origin + rows - pos.y;
+    }
+    if (state->adv_pos.x == pos.x && state->adv_pos.y == pos.y) {
+        return 0;
+    }
+    return manhattan_dist(state->pos, state->adv_pos) < limit;
+}
+
+// The state of actor i in map coordinates
+static server_message tile_get_state(tile *t, actor_t a, int i) {
+    coordinate pos = to_map(t, (a == HUNTER) ? t->hunters[i].pos : t->preys[i].pos);
+    server_message state;
+    int *target = (a == HUNTER) ? &t->h_targets[i] : &t->p_targets[i];
+    int slot = (a == HUNTER) ? 1 : 0;
+    int k, d, best = INT_MAX, blocks = t->count * t->blocks_x;
+
+    if (tile_strip_state(t->map, a, pos, t->origin, t->map_height, t->map_width, t->full_height, &state)) {
+        *target = -1;
+        return state;
+    }
+
+    // Anything past the halo is only known from the summary, keep what the strip found if nearer
+    if (state.adv_pos.x != pos.x || state.adv_pos.y != pos.y) {
+        best = manhattan_dist(pos, state.adv_pos);
+    }
+
+    // Only another tile's block can hold the adversary, our own rows are known
+    if (*target >= 0 && (*target / t->blocks_x == t->id || t->summary[*target * 2 + slot].count == 0
+                         || manhattan_dist(pos, t->summary[*target * 2 + slot].pos) >= best)) {
+        *target = -1;
+    }
+    if (*target < 0) {
+        for (k = 0; k < blocks; ++k) {
+            if (k / t->blocks_x == t->id || t->summary[k * 2 + slot].count == 0) {
+                continue;
+            }
+            if ((d = manhattan_dist(pos, t->summary[k * 2 + slot].pos)) < best) {
+                best = d;
+                *target = k;
+            }
+        }
+    }
+    if (*target >= 0) {
+        state.adv_pos = t->summary[*target * 2 + slot].pos;
+    }
+
+    return state;
+}
+
+static void send_state(tile *t, actor_t a, int i, uint8_t accepted, uint64_t t_read) {
+    server_message state;
+
+    if (a == HUNTER) {
+        state = tile_get_state(t, HUNTER, i);
+        write_all(t->pfd_h[i].fd, &state, sizeof(server_message));
+        telemetry_move(HUNTER, i, t->hunters[i].pos, t->hunters[i].energy, accepted, t_read, &state);
+    } else {
+        state = tile_get_state(t, PREY, i);
+        write_all(t->pfd_p[i].fd, &state, sizeof(server_message));
+        telemetry_move(PREY, i, t->preys[i].pos, t->preys[i].stored_energy, accepted, t_read, &state);
+    }
+}
+
+// Cells whose actor is leaving this tick are locked until the neighbour answers, c in map coordinates
+static int pending_departure(tile *t, coordinate c) {
+    int i;
+
+    for (i = 0; i < t->out_up_count; ++i) {
+        if (t->out_up[i].from.x == c.x && t->out_up[i].from.y == c.y) {
+            return 1;
+        }
+    }
+    for (i = 0; i < t->out_down_count; ++i) {
+        if (t->out_down[i].from.x == c.x && t->out_down[i].from.y == c.y) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void serve_request(tile *t, actor_t a, int i, uint8_t *map_updated) {
+    ph_message request;
+    migration m;
+    uint8_t accepted = 0;
+    uint64_t t_read = telemetry_now();
+    int fd = (a == HUNTER) ? t->pfd_h[i].fd : t->pfd_p[i].fd;
+    frame_reader *reader = (a == HUNTER) ? &t->h_readers[i] : &t->p_readers[i];
+
+    int frames = frame_read_latest(fd, reader, &request, 0);
+
+    if (frames <= 0) {
+        // The agent is gone, stop polling its socket; end_agent must not close it again
+        if (frames < 0) {
+            close(fd);
+            if (a == HUNTER) {
+                t->pfd_h[i].fd = -1;
+                t->h_pipes[i][0] = -1;
+            } else {
+                t->pfd_p[i].fd = -1;
+                t->p_pipes[i][0] = -1;
+            }
+        }
+        return;
+    }
+
+    // Moves that leave the strip are handed over to the neighbouring tile
+    if (request.move_request.y < t->y0 || request.move_request.y >= t->y1) {
+        m.type = a;
+        m.index = i;
+        m.to = request.move_request;
+        if (a == HUNTER) {
+            m.from = to_map(t, t->hunters[i].pos);
+            m.energy = t->hunters[i].energy;
+            m.target = t->h_targets[i];
+        } else {
+            m.from = to_map(t, t->preys[i].pos);
+            m.energy = t->preys[i].stored_energy;
+            m.target = t->p_targets[i];
+        }
+        if (m.to.y < t->y0) {
+            t->out_up[t->out_up_count++] = m;
+        } else {
+            t->out_down[t->out_down_count++] = m;
+        }
+        return;
+    }
+
+    if (!pending_departure(t, request.move_request)) {
+        request.move_request = to_strip(t, request.move_request);
+        accepted = kernel_request(request, t->map, t->hunters, t->preys, a, i, t->map_width);
+        *map_updated |= accepted;
+    }
+    send_state(t, a, i, accepted, t_read);
+}
+
+static void send_halo(tile *t, int fd, int row, migration *out, int out_count) {
+    write_all(fd, &out_count, sizeof(int));
+    write_all(fd, &t->map[get1D(0, row, t->map_width)], t->map_width * sizeof(uint16_t));
+    write_all(fd, out, out_count * sizeof(migration));
+}
+
+static int recv_halo(tile *t, int fd, int row, migration *in) {
+    int in_count;
+
+    read_all(fd, &in_count, sizeof(int));
+    read_all(fd, &t->map[get1D(0, row, t->map_width)], t->map_width * sizeof(uint16_t));
+    read_all(fd, in, in_count * sizeof(migration));
+    return in_count;
+}
+
+static int accept_migration(tile *t, migration *m) {
+    ph_message request;
+    uint8_t accepted = 0;
+    uint64_t t_read = telemetry_now();
+
+    request.move_request = to_strip(t, m->to);
+
+    if (!pending_departure(t, m->to)) {
+        // The actor still stands in our halo row, handle it like a local move
+        if (m->type == HUNTER) {
+            t->hunters[m->index].pos = to_strip(t, m->from);
+            t->hunters[m->index].energy = m->energy;
+            t->h_targets[m->index] = m->target;
+        } else {
+            t->preys[m->index].pos = to_strip(t, m->from);
+            t->preys[m->index].stored_energy = m->energy;
+            t->p_targets[m->index] = m->target;
+        }
+        accepted = kernel_request(request, t->map, t->hunters, t->preys, m->type, m->index, t->map_width);
+    }
+
+    if (accepted) {
+        if (m->type == HUNTER) {
+            t->hunters[m->index].alive = 1;
+            t->pfd_h[m->index].fd = t->h_pipes[m->index][0];
+        } else {
+            t->preys[m->index].alive = 1;
+            t->pfd_p[m->index].fd = t->p_pipes[m->index][0];
+        }
+        send_state(t, m->type, m->index, 1, t_read);
+    }
+
+    return accepted;
+}
+
+static void finish_departure(tile *t, migration *m, int accepted) {
+    coordinate from = to_strip(t, m->from);
+    uint16_t *cell = &t->map[get1D(from.x, from.y, t->map_width)];
+
+    if (!accepted) {
+        // Rejected by the neighbour, the actor stays where it is
+        send_state(t, m->type, m->index, 0, telemetry_now());
+        return;
+    }
+
+    if (decode_actor(*cell) == DOUBLE) {
+        *cell = (m->type == HUNTER) ? encode_actor(PREY, decode_index(*cell)) : HUNTER;
+    } else {
+        *cell = EMPTY;
+    }
+
+    if (m->type == HUNTER) {
+        t->hunters[m->index].alive = 0;
+        t->pfd_h[m->index].fd = -1;
+    } else {
+        t->preys[m->index].alive = 0;
+        t->pfd_p[m->index].fd = -1;
+    }
+}
+
+static uint8_t exchange_halos(tile *t) {
+    int i, in_up_count = 0, in_down_count = 0;
+    int first = t->y0 - t->origin, last = t->y1 - 1 - t->origin;
+    int actors = t->hunter_count + t->prey_count;
+    migration in_up[actors], in_down[actors];
+    migration_ack ack_up[actors], ack_down[actors];
+    uint8_t map_updated = 0;
+
+    // Send first, both neighbours do the same so nobody blocks on a read
+    if (t->up_fd >= 0) {
+        send_halo(t, t->up_fd, first, t->out_up, t->out_up_count);
+    }
+    if (t->down_fd >= 0) {
+        send_halo(t, t->down_fd, last, t->out_down, t->out_down_count);
+    }
+    if (t->up_fd >= 0) {
+        in_up_count = recv_halo(t, t->up_fd, first - 1, in_up);
+    }
+    if (t->down_fd >= 0) {
+        in_down_count = recv_halo(t, t->down_fd, last + 1, in_down);
+    }
+
+    // Resolve migrations into our rows
+    for (i = 0; i < in_up_count; ++i) {
+        ack_up[i].accepted = accept_migration(t, &in_up[i]);
+        map_updated |= ack_up[i].accepted;
+    }
+    for (i = 0; i < in_down_count; ++i) {
+        ack_down[i].accepted = accept_migration(t, &in_down[i]);
+        map_updated |= ack_down[i].accepted;
+    }
+
+    // Acks come back in the order the migrations were sent
+    if (t->up_fd >= 0) {
+        write_all(t->up_fd, ack_up, in_up_count * sizeof(migration_ack));
+    }
+    if (t->down_fd >= 0) {
+        write_all(t->down_fd, ack_down, in_down_count * sizeof(migration_ack));
+    }
+    if (t->up_fd >= 0) {
+        read_all(t->up_fd, ack_up, t->out_up_count * sizeof(migration_ack));
+        for (i = 0; i < t->out_up_count; ++i) {
+            finish_departure(t, &t->out_up[i], ack_up[i].accepted);
+            map_updated |= ack_up[i].accepted;
+        }
+    }
+    if (t->down_fd >= 0) {
+        read_all(t->down_fd, ack_down, t->out_down_count * sizeof(migration_ack));
+        for (i = 0; i < t->out_down_count; ++i) {
+            finish_departure(t, &t->out_down[i], ack_down[i].accepted);
+            map_updated |= ack_down[i].accepted;
+        }
+    }
+
+    t->out_up_count = 0;
+    t->out_down_count = 0;
+
+    return map_updated;
+}
+
+static void run_tile(tile *t) {
+    int i, dummy_hunters, dummy_preys;
+    block_summary counts[t->blocks_x * 2];
+    uint8_t map_updated;
+    tile_report report;
+    tile_control control;
+    char path[4096];
+
+    // Every tile records its own actors
+    if (t->telemetry_path != NULL) {
+        snprintf(path, sizeof path, "%s.%d", t->telemetry_path, t->id);
+        telemetry_open(path, t->hunter_count, t->prey_count);
+        telemetry_offset(t->origin);
+    }
+    placement_apply_tile(t->id);
+
+    // Introduce ourselves only once pinned, the coordinator reports where we run
+    write_all(t->ctl_fd, &t->id, sizeof(int));
+
+    // Take ownership of the actors on our rows
+    for (i = 0; i < t->hunter_count; ++i) {
+        if (t->hunters[i].alive && t->hunters[i].pos.y >= t->y0 && t->hunters[i].pos.y < t->y1) {
+            t->hunters[i].pos = to_strip(t, t->hunters[i].pos);
+            t->pfd_h[i].fd = t->h_pipes[i][0];
+        } else {
+            t->hunters[i].alive = 0;
+            t->pfd_h[i].fd = -1;
+        }
+        t->pfd_h[i].events = POLLIN;
+        t->h_targets[i] = -1;
+        frame_reader_init(&t->h_readers[i], sizeof(ph_message));
+    }
+
+    for (i = 0; i < t->prey_count; ++i) {
+        if (t->preys[i].alive && t->preys[i].pos.y >= t->y0 && t->preys[i].pos.y < t->y1) {
+            t->preys[i].pos = to_strip(t, t->preys[i].pos);
+            t->pfd_p[i].fd = t->p_pipes[i][0];
+        } else {
+            t->preys[i].alive = 0;
+            t->pfd_p[i].fd = -1;
+        }
+        t->pfd_p[i].events = POLLIN;
+        t->p_targets[i] = -1;
+        frame_reader_init(&t->p_readers[i], sizeof(ph_message));
+    }
+
+    while (1) {
+        map_updated = 0;
+
+        // Serve own agents - 1
+        poll(t->pfd_h, t->hunter_count, 0);
+        for (i = 0; i < t->hunter_count; ++i) {
+            if (t->pfd_h[i].fd >= 0 && (t->pfd_h[i].revents & POLLIN)) {
+                serve_request(t, HUNTER, i, &map_updated);
+            }
+        }
+
+        poll(t->pfd_p, t->prey_count, 0);
+        for (i = 0; i < t->prey_count; ++i) {
+            if (t->pfd_p[i].fd >= 0 && (t->pfd_p[i].revents & POLLIN)) {
+                serve_request(t, PREY, i, &map_updated);
+            }
+        }
+
+        // Swap halos and migrations with the neighbours - 2 3
+        map_updated |= exchange_halos(t);
+
+        // Resolve kills on our rows - 4
+        if (map_updated) {
+            update_map(t->map, t->map_width, t->hunters, t->hunter_count, t->preys, t->prey_count,
+                        &dummy_preys, &dummy_hunters, t->h_pipes, t->p_pipes, t->pfd_h, t->pfd_p);
+        }
+
+        // Report to the coordinator
+        memset(counts, 0, sizeof counts);
+        count_blocks(t->hunters, t->hunter_count, t->preys, t->prey_count,
+                     counts, t->blocks_x, 1, t->origin + t->map_height, t->origin);
+        report.hunters = 0;
+        report.preys = 0;
+        for (i = 0; i < t->blocks_x; ++i) {
+            report.hunters += counts[i * 2].count;
+            report.preys += counts[i * 2 + 1].count;
+        }
+        report.updated = map_updated;
+
+        write_all(t->ctl_fd, &report, sizeof(tile_report));
+        write_all(t->ctl_fd, counts, sizeof counts);
+        if (map_updated) {
+            write_all(t->ctl_fd, &t->map[get1D(0, t->y0 - t->origin, t->map_width)],
+                      (t->y1 - t->y0) * t->map_width * sizeof(uint16_t));
+        }
+
+        read_all(t->ctl_fd, &control, sizeof(tile_control));
+        if (control.summary_changed) {
+            read_all(t->ctl_fd, t->summary, t->count * t->blocks_x * 2 * sizeof(block_summary));
+        }
+
+        if (!control.running) {
+            kill_remaining(t->hunters, t->preys, t->hunter_count, t->prey_count,
+                           control.alive_hunters, control.alive_preys, t->h_pipes, t->p_pipes);
+            telemetry_close();
+            exit(0);
+        }
+    }
+}
+
+int run_distributed(uint16_t *map, int map_width, int map_height, Hunter *hunters, int hunter_count,
+                     Prey *preys, int prey_count, int h_pipes[][2], int p_pipes[][2], int tile_count,
+                     const char *telemetry_path, int *components, int component_count) {
+    int i, u, fd, y0, y1, any_updated, alive_actor_count, ctl_listen;
+    int reachable = preys_reachable(components, component_count, map, map_width, map_height);
+    int blocks_x = (map_width + SUMMARY_BLOCK - 1) / SUMMARY_BLOCK;
+    uint16_t ctl_port;
+    pid_t pid;
+    tile t;
+    tile_report report;
+    tile_control control = { 1, hunter_count, prey_count, 0 };
+
+    // A tile needs at least one row
+    if (tile_count > map_height) {
+        tile_count = map_height;
+    }
+
+    int ctl[tile_count];
+    pid_t tile_pids[tile_count];
+    int link_listen[tile_count];
+    uint16_t link_port[tile_count];
+    int summary_size = tile_count * blocks_x * 2;
+    block_summary *summary = calloc(summary_size, sizeof(block_summary));
+    block_summary *new_summary = calloc(summary_size, sizeof(block_summary));
+
+    count_blocks(hunters, hunter_count, preys, prey_count, summary, blocks_x, tile_count, map_height, 0);
+
+    // Tile i listens for tile i+1, everybody connects to the coordinator
+    ctl_listen = tcp_listen(&ctl_port);
+    for (i = 0; i < tile_count - 1; ++i) {
+        link_listen[i] = tcp_listen(&link_port[i]);
+    }
+
+    // Tiles must not inherit unflushed map output
+    fflush(stdout);
+
+    for (i = 0; i < tile_count; ++i) {
+        if ((pid = fork()) < 0) {
+            perror("Tile fork error");
+            exit(1);
+        } else if (pid == 0) { /* New Tile Process */
+            close(ctl_listen);
+            for (u = 0; u < tile_count - 1; ++u) {
+                if (u != i) {
+                    close(link_listen[u]);
+                }
+            }
+
+            t.id = i;
+            t.count = tile_count;
+            tile_rows(i, tile_count, map_height, &t.y0, &t.y1);
+
+            // Connecting first cannot block, the listener queues the link until accepted
+            t.up_fd = (i > 0) ? tcp_connect(link_port[i - 1]) : -1;
+            if (i < tile_count - 1) {
+                t.down_fd = tcp_accept(link_listen[i]);
+                close(link_listen[i]);
+            } else {
+                t.down_fd = -1;
+            }
+            t.ctl_fd = tcp_connect(ctl_port);
+
+            // Copy out the strip and its halo, the inherited map is never read again
+            tile_strip(t.y0, tile_count, map_height, &t.origin, &t.map_height);
+            t.map_width = map_width;
+            t.full_height = map_height;
+            t.map = malloc(t.map_height * map_width * sizeof(uint16_t));
+            memcpy(t.map, &map[get1D(0, t.origin, map_width)], t.map_height * map_width * sizeof(uint16_t));
+
+            t.hunters = hunters;
+            t.hunter_count = hunter_count;
+            t.preys = preys;
+            t.prey_count = prey_count;
+            t.h_pipes = h_pipes;
+            t.p_pipes = p_pipes;
+            t.pfd_h = calloc(hunter_count + 1, sizeof(struct pollfd));
+            t.pfd_p = calloc(prey_count + 1, sizeof(struct pollfd));
+            t.h_readers = malloc((hunter_count + 1) * sizeof(frame_reader));
+            t.p_readers = malloc((prey_count + 1) * sizeof(frame_reader));
+            t.h_targets = malloc((hunter_count + 1) * sizeof(int));
+            t.p_targets = malloc((prey_count + 1) * sizeof(int));
+            t.blocks_x = blocks_x;
+            t.summary = summary;
+            t.out_up = calloc(hunter_count + prey_count + 1, sizeof(migration));
+            t.out_down = calloc(hunter_count + prey_count + 1, sizeof(migration));
+            t.out_up_count = 0;
+            t.out_down_count = 0;
+            t.telemetry_path = telemetry_path;
+
+            run_tile(&t);
+        }
+        tile_pids[i] = pid;
+    }
+
+    // Coordinator keeps only the control channels, tiles introduce themselves by id
+    for (i = 0; i < tile_count - 1; ++i) {
+        close(link_listen[i]);
+    }
+    for (i = 0; i < tile_count; ++i) {
+        fd = tcp_accept(ctl_listen);
+        read_all(fd, &u, sizeof(int));
+        ctl[u] = fd;
+    }
+    close(ctl_listen);
+
+    render_start();
+    placement_apply_server();
+    placement_report(stderr, hunters, hunter_count, preys, prey_count);
+    for (i = 0; i < tile_count; ++i) {
+        placement_report_tile(stderr, i, tile_pids[i]);
+    }
+
+    for (i = 0; i < hunter_count; ++i) {
+        close(h_pipes[i][0]);
+    }
+    for (i = 0; i < prey_count; ++i) {
+        close(p_pipes[i][0]);
+    }
+
+    do {
+        any_updated = 0;
+        alive_actor_count = control.alive_hunters + control.alive_preys;
+        control.alive_hunters = 0;
+        control.alive_preys = 0;
+
+        for (i = 0; i < tile_count; ++i) {
+            read_all(ctl[i], &report, sizeof(tile_report));
+            read_all(ctl[i], &new_summary[i * blocks_x * 2], blocks_x * 2 * sizeof(block_summary));
+            if (report.updated) {
+                tile_rows(i, tile_count, map_height, &y0, &y1);
+                read_all(ctl[i], &map[get1D(0, y0, map_width)], (y1 - y0) * map_width * sizeof(uint16_t));
+                any_updated = 1;
+            }
+            control.alive_hunters += report.hunters;
+            control.alive_preys += report.preys;
+        }
+
+        if (any_updated) {
+            render_frame(map, map_width, map_height);
+        }
+
+        // Moves stay inside a component, only deaths can separate the sides
+        if (control.alive_hunters > 0 && control.alive_preys > 0
+            && control.alive_hunters + control.alive_preys != alive_actor_count) {
+            reachable = preys_reachable(components, component_count, map, map_width, map_height);
+        }
+
+        control.running = control.alive_hunters > 0 && control.alive_preys > 0 && reachable;
+        control.summary_changed = memcmp(summary, new_summary, summary_size * sizeof(block_summary)) != 0;
+        if (control.summary_changed) {
+            memcpy(summary, new_summary, summary_size * sizeof(block_summary));
+        }
+
+        for (i = 0; i < tile_count; ++i) {
+            write_all(ctl[i], &control, sizeof(tile_control));
+            if (control.summary_changed) {
+                write_all(ctl[i], summary, summary_size * sizeof(block_summary));
+            }
+        }
+    } while (control.running);
+
+    // Reap tiles and the agents they killed
+    while (wait(NULL) > 0);
+
+    for (i = 0; i < tile_count; ++i) {
+        close(ctl[i]);
+    }
+    free(summary);
+    free(new_summary);
+
+    return reachable;
+}
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "structs.h"
+#include "server.h"
+#include "framing.h"
+
+/*
+ * io_uring backend for the main loop. Every agent socket is a slot in a
+ * registered file table and owns a request and a reply buffer inside one
+ * registered buffer. Each slot keeps a READ_FIXED armed for its next
+ * ph_message; replying queues a WRITE_FIXED linked to the read that re-arms
+ * the slot. uring_wait submits everything queued during the previous tick and
+ * reaps the completions with a single io_uring_enter.
+ *
+ * Slots are numbered hunters first, then preys.
+ */
+
+// user_data is slot * 2 + op
+#define OP_READ 0
+#define OP_WRITE 1
+
+typedef struct uring_slot {
+    ph_message request;
+    server_message reply;
+} uring_slot;
+
+static int ring_fd = -1;
+static unsigned sq_entries;
+static atomic_uint *sq_head, *sq_tail, *cq_head, *cq_tail;
+static unsigned *sq_mask, *sq_array, *cq_mask;
+static struct io_uring_sqe *sqes = MAP_FAILED;
+static struct io_uring_cqe *cqes;
+static void *sq_ring = MAP_FAILED, *cq_ring = MAP_FAILED;
+static size_t sq_ring_size, cq_ring_size, sqes_size;
+static unsigned to_submit;
+
+static uring_slot *slots;
+static size_t *slot_fill;
+static int *slot_fds;
+static int slot_count;
+
+static int enter(unsigned submit, unsigned min_complete, unsigned flags) {
+    int ret;
+
+    do {
+        ret = syscall(__NR_io_uring_enter, ring_fd, submit, min_complete, flags, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+// Hands what we have to the kernel first when fewer than n entries are free
+static void make_room(unsigned n) {
+    unsigned tail = atomic_load_explicit(sq_tail, memory_order_relaxed);
+
+    if (sq_entries - (tail - atomic_load_explicit(sq_head, memory_order_acquire)) < n) {
+        if (enter(to_submit, 0, 0) < 0) {
+            perror("io_uring submit error");
+            exit(1);
+        }
+        to_submit = 0;
+    }
+}
+
+// Callers make room first
+static struct io_uring_sqe *next_sqe(void) {
+    unsigned tail = atomic_load_explicit(sq_tail, memory_order_relaxed);
+    struct io_uring_sqe *sqe;
+
+    sqe = &sqes[tail & *sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[tail & *sq_mask] = tail & *sq_mask;
+    return sqe;
+}
+
+static void push_sqe(void) {
+    atomic_store_explicit(sq_tail, atomic_load_explicit(sq_tail, memory_order_relaxed) + 1,
+                          memory_order_release);
+    to_submit++;
+}
+
+static void queue_read(int slot) {
+    struct io_uring_sqe *sqe = next_sqe();
+
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->fd = slot;
+    sqe->addr = (uint64_t)(uintptr_t)((char *)&slots[slot].request + slot_fill[slot]);
+    sqe->len = sizeof(ph_message) - slot_fill[slot];
+    sqe->buf_index = 0;
+    sqe->user_data = (uint64_t)slot * 2 + OP_READ;
+    push_sqe();
+}
+
+static void arm_read(int slot) {
+    make_room(1);
+    queue_read(slot);
+}
+
+int uring_open(int *fds, int count) {
+    struct io_uring_params p;
+    struct iovec iov;
+    int i;
+
+    memset(&p, 0, sizeof p);
+    for (sq_entries = 8; sq_entries < 2 * (unsigned)count; sq_entries <<= 1);
+
+    if ((ring_fd = syscall(__NR_io_uring_setup, sq_entries, &p)) < 0) {
+        return -1;
+    }
+    sq_entries = p.sq_entries;
+
+    sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cq_ring_size > sq_ring_size) {
+            sq_ring_size = cq_ring_size;
+        }
+        cq_ring_size = sq_ring_size;
+    }
+    sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring_fd, IORING_OFF_SQ_RING);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring = sq_ring;
+    } else {
+        cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd, IORING_OFF_CQ_RING);
+    }
+    sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring_fd, IORING_OFF_SQES);
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+        uring_close();
+        return -1;
+    }
+
+    sq_head = (atomic_uint *)((char *)sq_ring + p.sq_off.head);
+    sq_tail = (atomic_uint *)((char *)sq_ring + p.sq_off.tail);
+    sq_mask = (unsigned *)((char *)sq_ring + p.sq_off.ring_mask);
+    sq_array = (unsigned *)((char *)sq_ring + p.sq_off.array);
+    cq_head = (atomic_uint *)((char *)cq_ring + p.cq_off.head);
+    cq_tail = (atomic_uint *)((char *)cq_ring + p.cq_off.tail);
+    cq_mask = (unsigned *)((char *)cq_ring + p.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *)((char *)cq_ring + p.cq_off.cqes);
+
+    // Register the agent sockets and one buffer holding every slot
+    slot_count = count;
+    slots = aligned_alloc(4096, ((count * sizeof(uring_slot)) / 4096 + 1) * 4096);
+    slot_fill = calloc(count + 1, sizeof(size_t));
+    slot_fds = malloc((count + 1) * sizeof(int));
+    memcpy(slot_fds, fds, count * sizeof(int));
+
+    iov.iov_base = slots;
+    iov.iov_len = ((count * sizeof(uring_slot)) / 4096 + 1) * 4096;
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_FILES, fds, count) < 0
+        || syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+        uring_close();
+        return -1;
+    }
+
+    // Replies go out on the next tick, after update_map may have killed the
+    // agent; let those writes fail with EPIPE instead of killing the server
+    signal(SIGPIPE, SIG_IGN);
+
+    for (i = 0; i < count; ++i) {
+        arm_read(i);
+    }
+
+    return 0;
+}
+
+int uring_wait(uint8_t *ready) {
+    unsigned head, tail;
+    struct io_uring_cqe *cqe;
+    int slot, count = 0;
+
+    memset(ready, 0, slot_count);
+
+    if (enter(to_submit, 0, IORING_ENTER_GETEVENTS) < 0) {
+        perror("io_uring enter error");
+        exit(1);
+    }
+    to_submit = 0;
+
+    head = atomic_load_explicit(cq_head, memory_order_relaxed);
+    tail = atomic_load_explicit(cq_tail, memory_order_acquire);
+    for (; head != tail; ++head) {
+        cqe = &cqes[head & *cq_mask];
+        slot = cqe->user_data / 2;
+
+        if (cqe->user_data % 2 == OP_WRITE) {
+            // Replies are tiny, finish a short one synchronously
+            if (cqe->res > 0 && (size_t)cqe->res < sizeof(server_message)) {
+                write_frame(slot_fds[slot], (char *)&slots[slot].reply + cqe->res,
+                            sizeof(server_message) - cqe->res);
+            }
+            continue;
+        }
+
+        // A short reply breaks the link and cancels the read behind it
+        if (cqe->res == -ECANCELED) {
+            arm_read(slot);
+            continue;
+        }
+        // EOF or error: the agent is gone, leave the slot idle
+        if (cqe->res <= 0) {
+            continue;
+        }
+        slot_fill[slot] += cqe->res;
+        if (slot_fill[slot] < sizeof(ph_message)) {
+            arm_read(slot);
+            continue;
+        }
+        slot_fill[slot] = 0;
+        ready[slot] = 1;
+        count++;
+    }
+    atomic_store_explicit(cq_head, head, memory_order_release);
+
+    return count;
+}
+
+ph_message *uring_request(int slot) {
+    return &slots[slot].request;
+}
+
+void uring_reply(int slot, server_message *state) {
+    struct io_uring_sqe *sqe;
+
+    // The linked reply and read must go to the kernel in the same submission
+    make_room(2);
+    sqe = next_sqe();
+    slots[slot].reply = *state;
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+    sqe->fd = slot;
+    sqe->addr = (uint64_t)(uintptr_t)&slots[slot].reply;
+    sqe->len = sizeof(server_message);
+    sqe->buf_index = 0;
+    sqe->user_data = (uint64_t)slot * 2 + OP_WRITE;
+    push_sqe();
+
+    // The next request is read only once the reply is out
+    queue_read(slot);
+}
+
+// Also undoes a uring_open that failed part way, any mapping may be missing
+void uring_close(void) {
+    if (ring_fd < 0) {
+        return;
+    }
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != MAP_FAILED) {
+        munmap(sq_ring, sq_ring_size);
+    }
+    close(ring_fd);
+    ring_fd = -1;
+    sqes = MAP_FAILED;
+    sq_ring = MAP_FAILED;
+    cq_ring = MAP_FAILED;
+
+    free(slots);
+    free(slot_fill);
+    free(slot_fds);
+    slots = NULL;
+    slot_fill = NULL;
+    slot_fds = NULL;
+}